@@ -0,0 +1,260 @@
+#include "benchmark.h"
+#include "log_duration.h"
+#include "process_queries.h"
+#include "query_executor.h"
+#include "search_server.h"
+#include "shard_coordinator.h"
+#include "sharded_search_server.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std::string_literals;
+using namespace std::string_view_literals;
+
+namespace {
+    constexpr int BENCHMARK_DOCUMENT_COUNT = 50000;
+    constexpr int BENCHMARK_QUERY_COUNT = 2000;
+    constexpr size_t BENCHMARK_DICTIONARY_SIZE = 20000;
+    constexpr int BENCHMARK_DOCUMENT_LENGTH = 60;
+    constexpr int BENCHMARK_QUERY_LENGTH = 4;
+    constexpr size_t BENCHMARK_MAX_SHARD_COUNT = 8;
+    constexpr int BENCHMARK_CLUSTER_DOCUMENT_COUNT = 20000;
+    constexpr size_t BENCHMARK_MAX_CLUSTER_SHARD_COUNT = 4;
+    constexpr size_t BENCHMARK_CLUSTER_CLIENT_COUNT = 4;
+
+    std::vector<std::string> GenerateDictionary(std::mt19937& generator) {
+        std::uniform_int_distribution<int> length_distribution(3, 10);
+        std::uniform_int_distribution<int> letter_distribution('a', 'z');
+        std::vector<std::string> dictionary;
+        dictionary.reserve(BENCHMARK_DICTIONARY_SIZE);
+        for(size_t i = 0; i < BENCHMARK_DICTIONARY_SIZE; ++i) {
+            std::string word(length_distribution(generator), ' ');
+            for(char& c : word) {
+                c = static_cast<char>(letter_distribution(generator));
+            }
+            dictionary.push_back(std::move(word));
+        }
+        return dictionary;
+    }
+
+    // word i is drawn with a weight of 1 / (i + 1)
+    std::string GenerateText(std::mt19937& generator, const std::vector<std::string>& dictionary, 
+                             std::discrete_distribution<size_t>& word_distribution, int word_count) {
+        std::string text;
+        for(int i = 0; i < word_count; ++i) {
+            if(i > 0) {
+                text += ' ';
+            }
+            text += dictionary[word_distribution(generator)];
+        }
+        return text;
+    }
+
+    // documents and then queries of one synthetic corpus
+    std::pair<std::vector<std::string>, std::vector<std::string>> GenerateCorpus(int document_count, int query_count) {
+        std::mt19937 generator(42);
+        const std::vector<std::string> dictionary = GenerateDictionary(generator);
+        std::vector<double> weights(dictionary.size());
+        for(size_t i = 0; i < weights.size(); ++i) {
+            weights[i] = 1.0 / (i + 1);
+        }
+        std::discrete_distribution<size_t> word_distribution(weights.begin(), weights.end());
+
+        std::vector<std::string> texts;
+        texts.reserve(document_count);
+        for(int id = 0; id < document_count; ++id) {
+            texts.push_back(GenerateText(generator, dictionary, word_distribution, BENCHMARK_DOCUMENT_LENGTH));
+        }
+        std::vector<std::string> queries;
+        queries.reserve(query_count);
+        for(int i = 0; i < query_count; ++i) {
+            queries.push_back(GenerateText(generator, dictionary, word_distribution, BENCHMARK_QUERY_LENGTH));
+        }
+        return {std::move(texts), std::move(queries)};
+    }
+
+    // Starts shard_count copies of the running executable as shard nodes and
+    // connects to them, giving them time to start listening.
+    class ShardCluster {
+    public:
+        explicit ShardCluster(size_t shard_count) {
+            for(size_t i = 0; i < shard_count; ++i) {
+                endpoints_.push_back("unix:"s + (std::filesystem::temp_directory_path() / 
+                    ("search_shard_"s + std::to_string(getpid()) + "_"s + std::to_string(i) + ".sock"s)).string());
+                std::string program = "search_shard_node"s;
+                std::string mode = "--shard-node"s;
+                char* argv[] = {program.data(), mode.data(), endpoints_.back().data(), nullptr};
+                pid_t pid;
+                if(posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, argv, environ) != 0) {
+                    throw std::runtime_error("can't start shard node");
+                }
+                pids_.push_back(pid);
+            }
+        }
+
+        ShardCluster(const ShardCluster&) = delete;
+        ShardCluster& operator=(const ShardCluster&) = delete;
+
+        ~ShardCluster() {
+            try {
+                ShardCoordinator(endpoints_).Shutdown();
+            } catch(const std::exception&) {
+                for(pid_t pid : pids_) {
+                    kill(pid, SIGTERM);
+                }
+            }
+            for(pid_t pid : pids_) {
+                waitpid(pid, nullptr, 0);
+            }
+            for(const std::string& endpoint : endpoints_) {
+                std::filesystem::remove(endpoint.substr("unix:"sv.size()));
+            }
+        }
+
+        ShardCoordinator Connect() const {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while(true) {
+                try {
+                    return ShardCoordinator(endpoints_);
+                } catch(const std::runtime_error&) {
+                    if(std::chrono::steady_clock::now() > deadline) {
+                        throw;
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            }
+        }
+
+    private:
+        std::vector<std::string> endpoints_;
+        std::vector<pid_t> pids_;
+    };
+}
+
+void RunIndexBenchmark(std::ostream& out) {
+    const auto [texts, queries] = GenerateCorpus(BENCHMARK_DOCUMENT_COUNT, BENCHMARK_QUERY_COUNT);
+    SearchServer search_server(""s);
+    {
+        LOG_DURATION_STREAM("Indexing "s + std::to_string(BENCHMARK_DOCUMENT_COUNT) + " documents"s, out);
+        for(int id = 0; id < BENCHMARK_DOCUMENT_COUNT; ++id) {
+            search_server.AddDocument(id, texts[id], SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+    }
+
+    size_t result_count = 0;
+    {
+        LOG_DURATION_STREAM("Searching "s + std::to_string(BENCHMARK_QUERY_COUNT) + " queries"s, out);
+        result_count = ProcessQueriesJoined(search_server, queries).size();
+    }
+
+    QueryExecutor executor;
+    {
+        LOG_DURATION_STREAM("Searching "s + std::to_string(BENCHMARK_QUERY_COUNT) + " queries on "s 
+                            + std::to_string(executor.GetWorkerCount()) + " workers"s, out);
+        ProcessQueriesJoined(executor, search_server, queries);
+    }
+    const std::vector<QueryExecutor::WorkerStatistics> worker_statistics = executor.GetWorkerStatistics();
+    for(size_t i = 0; i < worker_statistics.size(); ++i) {
+        const QueryExecutor::WorkerStatistics& worker = worker_statistics[i];
+        out << (i < executor.GetWorkerCount() ? "Worker: "s : "Callers: "s) << worker.task_count_ << " tasks, "s << worker.stolen_chunk_count_ << " stolen chunks, "s 
+            << worker.utilization_ * 100.0 << "% busy"s << std::endl;
+    }
+
+    // one query at a time, so only the shards of a query run in parallel
+    std::vector<SearchServer::DocumentInput> documents;
+    documents.reserve(texts.size());
+    for(int id = 0; id < BENCHMARK_DOCUMENT_COUNT; ++id) {
+        documents.push_back({id, texts[id], SearchServer::DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    for(size_t shard_count = 1; shard_count <= BENCHMARK_MAX_SHARD_COUNT; shard_count *= 2) {
+        ShardedSearchServer sharded_server(""s, shard_count);
+        sharded_server.AddDocuments(documents);
+        LOG_DURATION_STREAM("Searching "s + std::to_string(BENCHMARK_QUERY_COUNT) + " queries on "s 
+                            + std::to_string(shard_count) + " shards"s, out);
+        for(const std::string& query : queries) {
+            sharded_server.FindTopDocuments(query);
+        }
+    }
+
+    const SearchServer::IndexStatistics statistics = search_server.GetIndexStatistics();
+    out << "Found documents: "s << result_count << std::endl;
+    out << "Postings: "s << statistics.posting_count_ << std::endl;
+    out << "Posting bytes: "s << statistics.posting_bytes_ << std::endl;
+    out << "Bytes per posting: "s 
+        << static_cast<double>(statistics.posting_bytes_) / std::max<size_t>(statistics.posting_count_, 1) << std::endl;
+}
+
+void RunShardClusterBenchmark(std::ostream& out) {
+    const auto [texts, queries] = GenerateCorpus(BENCHMARK_CLUSTER_DOCUMENT_COUNT, BENCHMARK_QUERY_COUNT);
+
+    for(size_t shard_count = 1; shard_count <= BENCHMARK_MAX_CLUSTER_SHARD_COUNT; shard_count *= 2) {
+        ShardCluster cluster(shard_count);
+        {
+            ShardCoordinator coordinator = cluster.Connect();
+            LOG_DURATION_STREAM("Indexing "s + std::to_string(BENCHMARK_CLUSTER_DOCUMENT_COUNT) + " documents on "s 
+                                + std::to_string(shard_count) + " shard nodes"s, out);
+            for(int id = 0; id < BENCHMARK_CLUSTER_DOCUMENT_COUNT; ++id) {
+                coordinator.AddDocument(id, texts[id], SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+            }
+        }
+
+        // every client has a coordinator of its own and takes the next query
+        std::vector<std::chrono::nanoseconds> latencies(queries.size());
+        std::atomic<size_t> next_query = 0;
+        // an exception must not escape a client thread, the first one is
+        // rethrown once all clients are joined
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        auto run_client = [&]() {
+            try {
+                ShardCoordinator coordinator = cluster.Connect();
+                for(size_t i = next_query++; i < queries.size(); i = next_query++) {
+                    const auto start = std::chrono::steady_clock::now();
+                    coordinator.FindTopDocuments(queries[i]);
+                    latencies[i] = std::chrono::steady_clock::now() - start;
+                }
+            } catch(...) {
+                std::lock_guard lock(error_mutex);
+                if(!error) {
+                    error = std::current_exception();
+                }
+                next_query = queries.size();
+            }
+        };
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> clients;
+        for(size_t i = 0; i < BENCHMARK_CLUSTER_CLIENT_COUNT; ++i) {
+            clients.emplace_back(run_client);
+        }
+        for(std::thread& client : clients) {
+            client.join();
+        }
+        if(error) {
+            std::rethrow_exception(error);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double fraction) {
+            const size_t index = std::min(latencies.size() - 1, static_cast<size_t>(fraction * latencies.size()));
+            return std::chrono::duration_cast<std::chrono::microseconds>(latencies[index]).count();
+        };
+        out << "Cluster of "s << shard_count << " shard nodes, "s << BENCHMARK_CLUSTER_CLIENT_COUNT << " clients: "s 
+            << static_cast<long>(queries.size() / elapsed.count()) << " queries/s, p50 "s << percentile(0.5) 
+            << " us, p99 "s << percentile(0.99) << " us, p99.9 "s << percentile(0.999) << " us"s << std::endl;
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <iostream>
+
+// Indexes a synthetic corpus with a Zipf-like word distribution and reports
+// timings and the memory taken by the postings.
+void RunIndexBenchmark(std::ostream& out);
+
+
+// Starts clusters of 1, 2 and 4 shard node processes, copies of the running
+// executable started with --shard-node, and reports the throughput and the
+// latency percentiles of concurrent clients querying them through
+// ShardCoordinators. Linux only.
+void RunShardClusterBenchmark(std::ostream& out);
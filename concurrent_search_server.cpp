@@ -0,0 +1,63 @@
+#include "concurrent_search_server.h"
+
+ConcurrentSearchServer::ConcurrentSearchServer(const SearchServer& search_server, 
+                                               std::chrono::microseconds grace_period)
+    : grace_period_(grace_period)
+    , snapshot_(MakeSnapshot(std::make_unique<SearchServer>(search_server), 0))
+    , standby_(std::make_unique<SearchServer>(search_server))
+{}
+
+std::shared_ptr<const SearchServer> ConcurrentSearchServer::GetSnapshot() const {
+    return snapshot_.load();
+}
+
+uint64_t ConcurrentSearchServer::GetVersion() const noexcept {
+    return version_.load();
+}
+
+std::vector<SearchServer::Document> ConcurrentSearchServer::FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status) const {
+    return GetSnapshot()->FindTopDocuments(raw_query, status);
+}
+
+std::vector<SearchServer::Document> ConcurrentSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return GetSnapshot()->FindTopDocuments(raw_query);
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return GetSnapshot()->GetDocumentCount();
+}
+
+std::tuple<std::vector<std::string>, SearchServer::DocumentStatus> 
+ConcurrentSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    return GetSnapshot()->MatchDocument(raw_query, document_id);
+}
+
+std::shared_ptr<const SearchServer> ConcurrentSearchServer::MakeSnapshot(
+        std::unique_ptr<SearchServer> search_server, uint64_t version) const {
+    return std::shared_ptr<const SearchServer>(search_server.release(), 
+        [retired = retired_, version](const SearchServer* snapshot) {
+            std::unique_ptr<SearchServer> owned(const_cast<SearchServer*>(snapshot));
+            std::lock_guard lock(retired->mutex_);
+            if(retired->wanted_version_ == version && !retired->search_server_) {
+                retired->search_server_ = std::move(owned);
+                retired->returned_.notify_one();
+            }
+        });
+}
+
+std::unique_ptr<SearchServer> ConcurrentSearchServer::TakeRetiredSnapshot(
+        std::shared_ptr<const SearchServer> previous, uint64_t version) {
+    {
+        std::lock_guard lock(retired_->mutex_);
+        retired_->wanted_version_ = version;
+    }
+    // if no query holds it, the deleter runs right here
+    previous.reset();
+
+    std::unique_lock lock(retired_->mutex_);
+    retired_->returned_.wait_for(lock, grace_period_, [this] {
+        return retired_->search_server_ != nullptr;
+    });
+    retired_->wanted_version_ = RetiredSnapshot::NO_VERSION;
+    return std::move(retired_->search_server_);
+}
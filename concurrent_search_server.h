@@ -0,0 +1,107 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "search_server.h"
+
+// Lets queries run while the index is being changed. Readers take an
+// immutable snapshot of the index with a single atomic load and never wait
+// for writers. A writer applies a batch of changes to a standby copy and
+// publishes it atomically. The previous snapshot is kept alive by the
+// queries still using it. When the last of them drops it, its deleter hands
+// it back to the writer instead of freeing it. If that happens within the
+// grace period, the writer replays the same batch on it, and it becomes the
+// next standby copy. Otherwise the writer copies the new snapshot into a
+// fresh standby, and the previous one is freed when its last query finishes.
+class ConcurrentSearchServer {
+public:
+    explicit ConcurrentSearchServer(const SearchServer& search_server, 
+                                    std::chrono::microseconds grace_period = std::chrono::milliseconds(10));
+    ConcurrentSearchServer(const ConcurrentSearchServer&) = delete;
+    ConcurrentSearchServer& operator=(const ConcurrentSearchServer&) = delete;
+
+    std::shared_ptr<const SearchServer> GetSnapshot() const;
+
+    // batch(SearchServer&) applies the changes. It is called twice, on both
+    // copies of the index, so it must give the same result both times. If
+    // its first call throws, nothing is published and the exception is
+    // rethrown. If only the replay throws, the standby copy is rebuilt from
+    // the published snapshot instead.
+    template <typename Batch>
+    void ApplyBatch(Batch batch) {
+        std::lock_guard lock(writer_mutex_);
+
+        try {
+            batch(*standby_);
+        } catch(...) {
+            standby_ = std::make_unique<SearchServer>(*snapshot_.load());
+            throw;
+        }
+        const uint64_t previous_version = version_.load();
+        std::shared_ptr<const SearchServer> previous = 
+            snapshot_.exchange(MakeSnapshot(std::move(standby_), previous_version + 1));
+        ++version_;
+
+        standby_ = TakeRetiredSnapshot(std::move(previous), previous_version);
+        if(standby_) {
+            try {
+                batch(*standby_);
+                return;
+            } catch(...) {
+                // the batch is already published, so only the copy is lost
+            }
+        }
+        standby_ = std::make_unique<SearchServer>(*snapshot_.load());
+    }
+
+    // number of batches published so far
+    uint64_t GetVersion() const noexcept;
+
+    template <typename DocumentPredicate>
+    std::vector<SearchServer::Document> FindTopDocuments(
+            std::string_view raw_query, DocumentPredicate document_predicate) const {
+        return GetSnapshot()->FindTopDocuments(raw_query, document_predicate);
+    }
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status) const;
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+    std::tuple<std::vector<std::string>, SearchServer::DocumentStatus> 
+    MatchDocument(std::string_view raw_query, int document_id) const;
+
+private:
+    // Where the deleter of a snapshot puts it if the writer waits for it.
+    // It is shared with the deleters, which may outlive the server. The
+    // mutex orders the last query's reads before the writer's changes.
+    struct RetiredSnapshot {
+        static constexpr uint64_t NO_VERSION = std::numeric_limits<uint64_t>::max();
+
+        std::mutex mutex_;
+        std::condition_variable returned_;
+        uint64_t wanted_version_ = NO_VERSION;
+        std::unique_ptr<SearchServer> search_server_;
+    };
+
+    const std::chrono::microseconds grace_period_;
+    const std::shared_ptr<RetiredSnapshot> retired_ = std::make_shared<RetiredSnapshot>();
+    std::atomic<std::shared_ptr<const SearchServer>> snapshot_;
+    std::atomic<uint64_t> version_ = 0;
+    std::mutex writer_mutex_;
+    std::unique_ptr<SearchServer> standby_;
+
+    std::shared_ptr<const SearchServer> MakeSnapshot(std::unique_ptr<SearchServer> search_server, uint64_t version) const;
+
+    // Drops the writer's reference to previous and waits up to the grace
+    // period for its queries to finish. Returns it then, or null.
+    std::unique_ptr<SearchServer> TakeRetiredSnapshot(std::shared_ptr<const SearchServer> previous, uint64_t version);
+};
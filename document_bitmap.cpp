@@ -0,0 +1,101 @@
+#include "document_bitmap.h"
+#include <algorithm>
+#include <bit>
+
+bool DocumentBitmap::Container::Contains(uint16_t low) const {
+    if(IsBitset()) {
+        return (bits_[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(values_.begin(), values_.end(), low);
+}
+
+bool DocumentBitmap::Container::Add(uint16_t low) {
+    if(IsBitset()) {
+        uint64_t& word = bits_[low >> 6];
+        const uint64_t mask = uint64_t{1} << (low & 63);
+        if(word & mask) {
+            return false;
+        }
+        word |= mask;
+        ++cardinality_;
+        return true;
+    }
+
+    auto it = std::lower_bound(values_.begin(), values_.end(), low);
+    if(it != values_.end() && *it == low) {
+        return false;
+    }
+    values_.insert(it, low);
+    ++cardinality_;
+
+    if(values_.size() > ARRAY_CONTAINER_LIMIT) {
+        bits_.assign(BITSET_WORD_COUNT, 0);
+        for(uint16_t value : values_) {
+            bits_[value >> 6] |= uint64_t{1} << (value & 63);
+        }
+        std::vector<uint16_t>().swap(values_);
+    }
+    return true;
+}
+
+bool DocumentBitmap::Container::Remove(uint16_t low) {
+    if(!IsBitset()) {
+        auto it = std::lower_bound(values_.begin(), values_.end(), low);
+        if(it == values_.end() || *it != low) {
+            return false;
+        }
+        values_.erase(it);
+        --cardinality_;
+        return true;
+    }
+
+    uint64_t& word = bits_[low >> 6];
+    const uint64_t mask = uint64_t{1} << (low & 63);
+    if(!(word & mask)) {
+        return false;
+    }
+    word &= ~mask;
+    --cardinality_;
+
+    if(cardinality_ <= ARRAY_CONTAINER_LIMIT / 2) {
+        values_.reserve(cardinality_);
+        for(size_t word_index = 0; word_index < bits_.size(); ++word_index) {
+            for(uint64_t bits = bits_[word_index]; bits != 0; bits &= bits - 1) {
+                values_.push_back(static_cast<uint16_t>(word_index * 64 + std::countr_zero(bits)));
+            }
+        }
+        std::vector<uint64_t>().swap(bits_);
+    }
+    return true;
+}
+
+void DocumentBitmap::Add(uint32_t value) {
+    const size_t key = value >> 16;
+    if(containers_.size() <= key) {
+        containers_.resize(key + 1);
+    }
+    if(containers_[key].Add(static_cast<uint16_t>(value))) {
+        ++cardinality_;
+    }
+}
+
+void DocumentBitmap::Remove(uint32_t value) {
+    const size_t key = value >> 16;
+    if(key < containers_.size() && containers_[key].Remove(static_cast<uint16_t>(value))) {
+        --cardinality_;
+    }
+}
+
+bool DocumentBitmap::Contains(uint32_t value) const {
+    const size_t key = value >> 16;
+    return key < containers_.size() && containers_[key].Contains(static_cast<uint16_t>(value));
+}
+
+size_t DocumentBitmap::Cardinality() const noexcept {
+    return cardinality_;
+}
+
+void DocumentBitmap::Clear() noexcept {
+    containers_.clear();
+    cardinality_ = 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compressed set of document ordinals in the spirit of roaring bitmaps.
+// Values are split by their high 16 bits into containers that hold the low
+// bits either as a sorted array (sparse) or as a 65536-bit bitset (dense).
+// Ordinals are dense, so containers are indexed directly by the high bits.
+class DocumentBitmap {
+public:
+    void Add(uint32_t value);
+    void Remove(uint32_t value);
+    bool Contains(uint32_t value) const;
+    size_t Cardinality() const noexcept;
+    void Clear() noexcept;
+
+private:
+    // an array container turns into a bitset above this size and back at half of it
+    static constexpr size_t ARRAY_CONTAINER_LIMIT = 4096;
+    static constexpr size_t BITSET_WORD_COUNT = 65536 / 64;
+
+    struct Container {
+        std::vector<uint16_t> values_;
+        std::vector<uint64_t> bits_;
+        uint32_t cardinality_ = 0;
+
+        bool IsBitset() const noexcept {
+            return !bits_.empty();
+        }
+        bool Contains(uint16_t low) const;
+        bool Add(uint16_t low);
+        bool Remove(uint16_t low);
+    };
+
+    std::vector<Container> containers_;
+    size_t cardinality_ = 0;
+};
@@ -0,0 +1,428 @@
+#include "index_snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char SNAPSHOT_MAGIC[8] = {'S', 'S', 'I', 'N', 'D', 'E', 'X', '\0'};
+
+    template <typename Entry>
+    uint64_t WriteSection(std::ofstream& out, const std::vector<Entry>& entries) {
+        static const char padding[8] = {};
+        uint64_t offset = static_cast<uint64_t>(out.tellp());
+        if(offset % 8 != 0) {
+            out.write(padding, 8 - offset % 8);
+            offset += 8 - offset % 8;
+        }
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+        return offset;
+    }
+
+    void CheckEntry(bool is_valid) {
+        if(!is_valid) {
+            throw std::runtime_error("index snapshot is corrupted"s);
+        }
+    }
+
+    // flushes a written file, or the entries of a directory, to the disk
+    void SyncPath(const std::string& path, int flags) {
+        int fd = ::open(path.c_str(), flags);
+        if(fd < 0) {
+            throw std::runtime_error("can't open "s + path + " to sync it"s);
+        }
+        const int result = ::fsync(fd);
+        ::close(fd);
+        if(result != 0) {
+            throw std::runtime_error("can't sync "s + path);
+        }
+    }
+}
+
+void IndexSnapshot::Save(const SearchServer& search_server, const std::string& path) {
+    std::vector<char> strings;
+    auto store_string = [&strings](std::string_view s) {
+        uint64_t offset = strings.size();
+        strings.insert(strings.end(), s.begin(), s.end());
+        return offset;
+    };
+
+    std::vector<StopWordEntry> stop_words;
+    stop_words.reserve(search_server.stop_words_.size());
+    for(const std::string& word : search_server.stop_words_) {
+        stop_words.push_back({store_string(word), word.size()});
+    }
+
+    // terms that still occur in some document, in lexicographic order
+    const TermDictionary& dictionary = search_server.terms_;
+    std::vector<TermId> term_ids;
+    for(TermId term_id = 0; term_id < search_server.term_to_postings_.size(); ++term_id) {
+        if(search_server.CountLiveDocuments(term_id) > 0) {
+            term_ids.push_back(term_id);
+        }
+    }
+    std::sort(term_ids.begin(), term_ids.end(), [&dictionary](TermId lhs, TermId rhs) {
+        return dictionary.GetTerm(lhs) < dictionary.GetTerm(rhs);
+    });
+    std::vector<uint32_t> term_id_to_index(dictionary.size(), NO_INDEX);
+    for(uint32_t index = 0; index < term_ids.size(); ++index) {
+        term_id_to_index[term_ids[index]] = index;
+    }
+
+    std::vector<DocumentEntry> documents;
+    std::vector<DocumentTermEntry> document_terms;
+    std::vector<uint32_t> ordinal_to_index(search_server.document_ids_.size(), NO_INDEX);
+    documents.reserve(search_server.id_to_ordinal_.size());
+    for(const auto& [document_id, ordinal] : search_server.id_to_ordinal_) {
+        ordinal_to_index[ordinal] = static_cast<uint32_t>(documents.size());
+        uint64_t terms_begin = document_terms.size();
+        for(const auto& [term_id, count] : search_server.ordinal_to_term_counts_[ordinal]) {
+            document_terms.push_back({term_id_to_index[term_id], 0, search_server.GetTf(ordinal, count)});
+        }
+        std::sort(document_terms.begin() + terms_begin, document_terms.end(), 
+            [](const DocumentTermEntry& lhs, const DocumentTermEntry& rhs) {
+                return lhs.term_index_ < rhs.term_index_;
+            });
+        documents.push_back({document_id, search_server.ratings_[ordinal], static_cast<int32_t>(search_server.statuses_[ordinal]), 0, 
+                             terms_begin, document_terms.size()});
+    }
+
+    std::vector<TermEntry> terms;
+    std::vector<PostingEntry> postings;
+    terms.reserve(term_ids.size());
+    for(TermId term_id : term_ids) {
+        std::string_view term = dictionary.GetTerm(term_id);
+        uint64_t postings_begin = postings.size();
+        for(PostingCursor cursor(search_server.term_to_postings_[term_id]); !cursor.IsEnd(); cursor.Next()) {
+            // postings of removed documents that are not dropped yet
+            if(ordinal_to_index[cursor.GetOrdinal()] == NO_INDEX) {
+                continue;
+            }
+            postings.push_back({ordinal_to_index[cursor.GetOrdinal()], 0, 
+                                search_server.GetTf(cursor.GetOrdinal(), cursor.GetCount())});
+        }
+        // ordinals don't follow ids, document indexes do
+        std::sort(postings.begin() + postings_begin, postings.end(), 
+            [](const PostingEntry& lhs, const PostingEntry& rhs) {
+                return lhs.document_index_ < rhs.document_index_;
+            });
+        terms.push_back({store_string(term), term.size(), postings_begin, postings.size()});
+    }
+
+    // the snapshot is written next to the target, synced and renamed over
+    // it, so a crash never leaves a half written file under the final name;
+    // a failed save removes its temporary file
+    const std::string tmp_path = path + ".tmp"s;
+    try {
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            if(!out) {
+                throw std::runtime_error("can't create index snapshot "s + tmp_path);
+            }
+
+            Header header = {};
+            std::memcpy(header.magic_, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+            header.version_ = FORMAT_VERSION;
+            header.stop_word_count_ = stop_words.size();
+            header.term_count_ = terms.size();
+            header.document_count_ = documents.size();
+            header.posting_count_ = postings.size();
+            header.document_term_count_ = document_terms.size();
+            header.string_bytes_ = strings.size();
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            header.stop_words_offset_ = WriteSection(out, stop_words);
+            header.terms_offset_ = WriteSection(out, terms);
+            header.documents_offset_ = WriteSection(out, documents);
+            header.postings_offset_ = WriteSection(out, postings);
+            header.document_terms_offset_ = WriteSection(out, document_terms);
+            header.strings_offset_ = WriteSection(out, strings);
+
+            out.seekp(0);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            if(!out) {
+                throw std::runtime_error("can't write index snapshot "s + tmp_path);
+            }
+        }
+        SyncPath(tmp_path, O_RDONLY);
+        std::filesystem::rename(tmp_path, path);
+    } catch(...) {
+        std::error_code error;
+        std::filesystem::remove(tmp_path, error);
+        throw;
+    }
+    // the rename itself only lasts once the directory is synced
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    SyncPath(directory.empty() ? "."s : directory.string(), O_RDONLY | O_DIRECTORY);
+}
+
+IndexSnapshot::IndexSnapshot(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("can't open index snapshot "s + path);
+    }
+
+    struct stat file_stat;
+    if(::fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error("index snapshot "s + path + " is truncated"s);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+
+    void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(mapping == MAP_FAILED) {
+        throw std::runtime_error("can't map index snapshot "s + path);
+    }
+    data_ = static_cast<const char*>(mapping);
+
+    try {
+        MapSections();
+    } catch(...) {
+        Unmap();
+        throw;
+    }
+}
+
+IndexSnapshot::IndexSnapshot(IndexSnapshot&& other) noexcept {
+    *this = std::move(other);
+}
+
+IndexSnapshot& IndexSnapshot::operator=(IndexSnapshot&& other) noexcept {
+    if(this != &other) {
+        Unmap();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        header_ = std::exchange(other.header_, nullptr);
+        stop_words_ = std::exchange(other.stop_words_, nullptr);
+        terms_ = std::exchange(other.terms_, nullptr);
+        documents_ = std::exchange(other.documents_, nullptr);
+        postings_ = std::exchange(other.postings_, nullptr);
+        document_terms_ = std::exchange(other.document_terms_, nullptr);
+        strings_ = std::exchange(other.strings_, nullptr);
+    }
+    return *this;
+}
+
+IndexSnapshot::~IndexSnapshot() {
+    Unmap();
+}
+
+std::vector<SearchServer::Document> IndexSnapshot::FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status) const {
+    auto pred = [status](int id, SearchServer::DocumentStatus s, int r) {
+        return s == status;
+    };
+
+    return FindTopDocuments(raw_query, pred);
+}
+
+std::vector<SearchServer::Document> IndexSnapshot::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, SearchServer::DocumentStatus::ACTUAL);
+}
+
+int IndexSnapshot::GetDocumentCount() const noexcept {
+    return static_cast<int>(header_->document_count_);
+}
+
+std::tuple<std::vector<std::string>, SearchServer::DocumentStatus> 
+IndexSnapshot::MatchDocument(std::string_view raw_query, int document_id) const {
+    const SearchServer::Query query_terms = ParseQuery(raw_query);
+    const DocumentEntry& document = documents_[FindDocument(document_id)];
+    const DocumentTermEntry* terms_begin = document_terms_ + document.terms_begin_;
+    const DocumentTermEntry* terms_end = document_terms_ + document.terms_end_;
+    const SearchServer::DocumentStatus status = static_cast<SearchServer::DocumentStatus>(document.status_);
+
+    auto contains = [terms_begin, terms_end](uint32_t term_index) {
+        const DocumentTermEntry* it = std::lower_bound(terms_begin, terms_end, term_index, 
+            [](const DocumentTermEntry& entry, uint32_t index) {
+                return entry.term_index_ < index;
+            });
+        return it != terms_end && it->term_index_ == term_index;
+    };
+
+    for(TermId mt : query_terms.minus_terms_) {
+        if(contains(mt)) {
+            return {std::vector<std::string>{}, status};
+        }
+    }
+    // term indexes follow the lexicographic order of the words
+    std::vector<std::string> plus_words;
+    for(TermId pt : query_terms.plus_terms_) {
+        if(contains(pt)) {
+            plus_words.emplace_back(GetString(terms_[pt].offset_, terms_[pt].length_));
+        }
+    }
+    return {plus_words, status};
+}
+
+std::map<std::string_view, double> IndexSnapshot::GetWordFrequencies(int document_id) const {
+    std::map<std::string_view, double> word_freqs;
+    auto documents_end = documents_ + header_->document_count_;
+    auto it = std::lower_bound(documents_, documents_end, document_id, 
+        [](const DocumentEntry& entry, int id) {
+            return entry.id_ < id;
+        });
+    if(it != documents_end && it->id_ == document_id) {
+        for(uint64_t i = it->terms_begin_; i < it->terms_end_; ++i) {
+            CheckEntry(document_terms_[i].term_index_ < header_->term_count_);
+            const TermEntry& term = terms_[document_terms_[i].term_index_];
+            word_freqs.emplace(GetString(term.offset_, term.length_), document_terms_[i].tf_);
+        }
+    }
+    return word_freqs;
+}
+
+void IndexSnapshot::MapSections() {
+    header_ = reinterpret_cast<const Header*>(data_);
+    if(std::memcmp(header_->magic_, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw std::runtime_error("file is not an index snapshot"s);
+    }
+    if(header_->version_ != FORMAT_VERSION) {
+        throw std::runtime_error("unsupported index snapshot version "s + std::to_string(header_->version_));
+    }
+
+    auto section = [this](uint64_t offset, uint64_t count, size_t entry_size) {
+        if(offset % 8 != 0 || offset > size_ || count > (size_ - offset) / entry_size) {
+            throw std::runtime_error("index snapshot is truncated"s);
+        }
+        return data_ + offset;
+    };
+    stop_words_ = reinterpret_cast<const StopWordEntry*>(
+        section(header_->stop_words_offset_, header_->stop_word_count_, sizeof(StopWordEntry)));
+    terms_ = reinterpret_cast<const TermEntry*>(
+        section(header_->terms_offset_, header_->term_count_, sizeof(TermEntry)));
+    documents_ = reinterpret_cast<const DocumentEntry*>(
+        section(header_->documents_offset_, header_->document_count_, sizeof(DocumentEntry)));
+    postings_ = reinterpret_cast<const PostingEntry*>(
+        section(header_->postings_offset_, header_->posting_count_, sizeof(PostingEntry)));
+    document_terms_ = reinterpret_cast<const DocumentTermEntry*>(
+        section(header_->document_terms_offset_, header_->document_term_count_, sizeof(DocumentTermEntry)));
+    strings_ = section(header_->strings_offset_, header_->string_bytes_, 1);
+    ValidateSections();
+}
+
+void IndexSnapshot::ValidateSections() const {
+    // queries index the sections with these without further checks
+    auto check_string = [this](uint64_t offset, uint64_t length) {
+        CheckEntry(offset <= header_->string_bytes_ && length <= header_->string_bytes_ - offset);
+    };
+    auto check_range = [](uint64_t begin, uint64_t end, uint64_t count) {
+        CheckEntry(begin <= end && end <= count);
+    };
+
+    for(uint64_t i = 0; i < header_->stop_word_count_; ++i) {
+        check_string(stop_words_[i].offset_, stop_words_[i].length_);
+    }
+    for(uint64_t i = 0; i < header_->term_count_; ++i) {
+        check_string(terms_[i].offset_, terms_[i].length_);
+        check_range(terms_[i].postings_begin_, terms_[i].postings_end_, header_->posting_count_);
+    }
+    for(uint64_t i = 0; i < header_->document_count_; ++i) {
+        check_range(documents_[i].terms_begin_, documents_[i].terms_end_, header_->document_term_count_);
+        CheckEntry(documents_[i].status_ >= 0
+                   && documents_[i].status_ <= static_cast<int32_t>(SearchServer::DocumentStatus::REMOVED));
+    }
+}
+
+void IndexSnapshot::Verify() const {
+    for(uint64_t i = 0; i < header_->posting_count_; ++i) {
+        CheckEntry(postings_[i].document_index_ < header_->document_count_);
+    }
+    for(uint64_t i = 0; i < header_->document_term_count_; ++i) {
+        CheckEntry(document_terms_[i].term_index_ < header_->term_count_);
+    }
+}
+
+void IndexSnapshot::Unmap() noexcept {
+    if(data_ != nullptr) {
+        ::munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+std::string_view IndexSnapshot::GetString(uint64_t offset, uint64_t length) const {
+    return {strings_ + offset, length};
+}
+
+bool IndexSnapshot::IsStopWord(std::string_view word) const {
+    auto stop_words_end = stop_words_ + header_->stop_word_count_;
+    auto it = std::lower_bound(stop_words_, stop_words_end, word, 
+        [this](const StopWordEntry& entry, std::string_view w) {
+            return GetString(entry.offset_, entry.length_) < w;
+        });
+    return it != stop_words_end && GetString(it->offset_, it->length_) == word;
+}
+
+uint32_t IndexSnapshot::FindTerm(std::string_view word) const {
+    auto terms_end = terms_ + header_->term_count_;
+    auto it = std::lower_bound(terms_, terms_end, word, 
+        [this](const TermEntry& entry, std::string_view w) {
+            return GetString(entry.offset_, entry.length_) < w;
+        });
+    if(it != terms_end && GetString(it->offset_, it->length_) == word) {
+        return static_cast<uint32_t>(it - terms_);
+    }
+    return NO_INDEX;
+}
+
+uint32_t IndexSnapshot::FindDocument(int document_id) const {
+    auto documents_end = documents_ + header_->document_count_;
+    auto it = std::lower_bound(documents_, documents_end, document_id, 
+        [](const DocumentEntry& entry, int id) {
+            return entry.id_ < id;
+        });
+    if(it == documents_end || it->id_ != document_id) {
+        throw std::out_of_range("document "s + std::to_string(document_id) + " is not in the snapshot"s);
+    }
+    return static_cast<uint32_t>(it - documents_);
+}
+
+SearchServer::Document IndexSnapshot::GetDocument(uint32_t document_index) const {
+    const DocumentEntry& entry = documents_[document_index];
+    return {entry.id_, entry.rating_, static_cast<SearchServer::DocumentStatus>(entry.status_)};
+}
+
+SearchServer::Query IndexSnapshot::ParseQuery(std::string_view raw_query) const {
+    SearchServer::Query query_terms;
+    auto is_stop_word = [this](std::string_view word) {
+        return IsStopWord(word);
+    };
+    ForEachQueryWord(raw_query, is_stop_word, [this, &query_terms](std::string_view word, bool is_minus) {
+        if(uint32_t term_index = FindTerm(word); term_index != NO_INDEX) {
+            (is_minus ? query_terms.minus_terms_ : query_terms.plus_terms_).push_back(term_index);
+        }
+    });
+    SearchServer::NormalizeQuery(query_terms);
+    return query_terms;
+}
+
+std::unordered_map<uint32_t, double> IndexSnapshot::ComputeDocumentRelevance(std::string_view raw_query) const {
+    const SearchServer::Query query_terms = ParseQuery(raw_query);
+    std::unordered_map<uint32_t, double> document_to_relevance;
+
+    for(uint32_t plus_term : query_terms.plus_terms_) {
+        const TermEntry& term = terms_[plus_term];
+        double idf = SearchServer::ComputeIdf(static_cast<int>(header_->document_count_), 
+                                              static_cast<int>(term.postings_end_ - term.postings_begin_));
+        for(uint64_t i = term.postings_begin_; i < term.postings_end_; ++i) {
+            CheckEntry(postings_[i].document_index_ < header_->document_count_);
+            document_to_relevance[postings_[i].document_index_] += postings_[i].tf_ * idf;
+        }
+    }
+
+    for(uint32_t minus_term : query_terms.minus_terms_) {
+        const TermEntry& term = terms_[minus_term];
+        for(uint64_t i = term.postings_begin_; i < term.postings_end_; ++i) {
+            document_to_relevance.erase(postings_[i].document_index_);
+        }
+    }
+
+    return document_to_relevance;
+}
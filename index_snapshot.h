@@ -0,0 +1,154 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "search_server.h"
+
+// Read-only copy of a SearchServer index stored in a versioned binary file.
+// The file is memory mapped on construction and queried in place: nothing
+// is deserialized, so opening costs an mmap call and later page faults.
+// Opening checks the header and the term and document entries, postings
+// are checked by the queries reading them.
+// The layout uses the native byte order of the machine that wrote it.
+class IndexSnapshot {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    static void Save(const SearchServer& search_server, const std::string& path);
+
+    explicit IndexSnapshot(const std::string& path);
+    IndexSnapshot(const IndexSnapshot&) = delete;
+    IndexSnapshot& operator=(const IndexSnapshot&) = delete;
+    IndexSnapshot(IndexSnapshot&& other) noexcept;
+    IndexSnapshot& operator=(IndexSnapshot&& other) noexcept;
+    ~IndexSnapshot();
+
+    template <typename DocumentPredicate>
+    std::vector<SearchServer::Document> FindTopDocuments(
+            std::string_view raw_query, DocumentPredicate document_predicate) const {
+
+        std::vector<SearchServer::Document> top_documents;
+        top_documents.reserve(MAX_RESULT_DOCUMENT_COUNT + 1);
+
+        for(const auto& [document_index, relevance] : ComputeDocumentRelevance(raw_query)) {
+            const SearchServer::Document document = GetDocument(document_index);
+            if(!document_predicate(document.id_, document.status_, document.rating_)) {
+                continue;
+            }
+            SearchServer::PushTopDocument(top_documents, document, relevance);
+        }
+        std::sort_heap(top_documents.begin(), top_documents.end(), SearchServer::IsMoreRelevant);
+        return top_documents;
+    }
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status) const;
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query) const;
+
+    int GetDocumentCount() const noexcept;
+
+    std::tuple<std::vector<std::string>, SearchServer::DocumentStatus> 
+    MatchDocument(std::string_view raw_query, int document_id) const;
+
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    // Checks every posting and document term up front, which reads the whole
+    // file. Throws std::runtime_error if the snapshot is corrupted.
+    void Verify() const;
+
+private:
+    // every section starts at an offset that is a multiple of 8
+    struct Header {
+        char magic_[8];
+        uint32_t version_;
+        uint32_t reserved_;
+        uint64_t stop_word_count_;
+        uint64_t term_count_;
+        uint64_t document_count_;
+        uint64_t posting_count_;
+        uint64_t document_term_count_;
+        uint64_t string_bytes_;
+        uint64_t stop_words_offset_;
+        uint64_t terms_offset_;
+        uint64_t documents_offset_;
+        uint64_t postings_offset_;
+        uint64_t document_terms_offset_;
+        uint64_t strings_offset_;
+    };
+
+    // stop words sorted lexicographically
+    struct StopWordEntry {
+        uint64_t offset_;
+        uint64_t length_;
+    };
+
+    // terms sorted lexicographically, with their range in the postings section
+    struct TermEntry {
+        uint64_t offset_;
+        uint64_t length_;
+        uint64_t postings_begin_;
+        uint64_t postings_end_;
+    };
+
+    // documents sorted by id, with their range in the document terms section
+    struct DocumentEntry {
+        int32_t id_;
+        int32_t rating_;
+        int32_t status_;
+        uint32_t reserved_;
+        uint64_t terms_begin_;
+        uint64_t terms_end_;
+    };
+
+    // postings of a term sorted by document index
+    struct PostingEntry {
+        uint32_t document_index_;
+        uint32_t reserved_;
+        double tf_;
+    };
+
+    // terms of a document sorted by term index
+    struct DocumentTermEntry {
+        uint32_t term_index_;
+        uint32_t reserved_;
+        double tf_;
+    };
+
+    static constexpr uint32_t NO_INDEX = UINT32_MAX;
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    const Header* header_ = nullptr;
+    const StopWordEntry* stop_words_ = nullptr;
+    const TermEntry* terms_ = nullptr;
+    const DocumentEntry* documents_ = nullptr;
+    const PostingEntry* postings_ = nullptr;
+    const DocumentTermEntry* document_terms_ = nullptr;
+    const char* strings_ = nullptr;
+
+    void MapSections();
+
+    // throws std::runtime_error if a term or document entry points outside
+    // of its section
+    void ValidateSections() const;
+
+    void Unmap() noexcept;
+
+    std::string_view GetString(uint64_t offset, uint64_t length) const;
+
+    bool IsStopWord(std::string_view word) const;
+
+    uint32_t FindTerm(std::string_view word) const;
+
+    uint32_t FindDocument(int document_id) const;
+
+    SearchServer::Document GetDocument(uint32_t document_index) const;
+
+    SearchServer::Query ParseQuery(std::string_view raw_query) const;
+
+    std::unordered_map<uint32_t, double> ComputeDocumentRelevance(std::string_view raw_query) const;
+};
@@ -1,5 +1,7 @@
+#include "benchmark.h"
 #include "process_queries.h"
 #include "search_server.h"
+#include "shard_node.h"
 
 #include <iostream>
 #include <string>
@@ -7,7 +9,22 @@
 
 using namespace std;
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && argv[1] == "--benchmark"s) {
+        RunIndexBenchmark(cout);
+        return 0;
+    }
+    if (argc > 1 && argv[1] == "--cluster-benchmark"s) {
+        RunShardClusterBenchmark(cout);
+        return 0;
+    }
+    // --shard-node <endpoint> [stop words]
+    if (argc > 2 && argv[1] == "--shard-node"s) {
+        ShardNode node(SearchServer(argc > 3 ? string(argv[3]) : ""s), argv[2]);
+        node.Serve();
+        return 0;
+    }
+
     SearchServer search_server("and with"s);
 
     int id = 0;
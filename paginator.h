@@ -1,8 +1,16 @@
 #pragma once
+#include <algorithm>
+#include <compare>
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 template <typename Iterator>
-class IteratorRange {   
+class IteratorRange {
 private:
     Iterator begin_;
     Iterator end_;
@@ -20,24 +28,137 @@ public:
     }
 };
 
+// View of a range split into pages. Page boundaries are computed when a page
+// is read: in O(1) for random-access iterators, by walking from the previous
+// page while iterating otherwise, so no page list is ever built.
 template <typename Iterator>
 class Paginator {
 private:
-    std::vector<IteratorRange<Iterator>> pages_;
+    static constexpr bool IS_RANDOM_ACCESS = std::random_access_iterator<Iterator>;
+
+    Iterator begin_;
+    Iterator end_;
+    size_t page_size_;
+    size_t item_count_;
+
 public:
-    Paginator(Iterator begin, Iterator end, size_t page_size) {
-        while(begin != end) {
-            Iterator current_end = begin;
-            size_t step = std::min(page_size, static_cast<size_t>(std::distance(begin, end)));
-            std::advance(current_end, step);
-            pages_.emplace_back(begin, current_end);
-            begin = current_end;
+    using Page = IteratorRange<Iterator>;
+
+    class PageIterator {
+    public:
+        using iterator_category = std::conditional_t<IS_RANDOM_ACCESS, std::random_access_iterator_tag, std::forward_iterator_tag>;
+        using value_type = Page;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Page;
+
+        PageIterator() = default;
+
+        PageIterator(const Paginator* paginator, size_t page_index, Iterator page_begin)
+            : paginator_(paginator), page_index_(page_index), page_begin_(page_begin) {}
+
+        Page operator*() const {
+            return Page(page_begin_, paginator_->GetPageEnd(page_index_, page_begin_));
+        }
+
+        PageIterator& operator++() {
+            page_begin_ = paginator_->GetPageEnd(page_index_, page_begin_);
+            ++page_index_;
+            return *this;
+        }
+
+        PageIterator operator++(int) {
+            PageIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const PageIterator& other) const {
+            return page_index_ == other.page_index_;
+        }
+
+        PageIterator& operator--() requires IS_RANDOM_ACCESS {
+            return *this -= 1;
+        }
+
+        PageIterator operator--(int) requires IS_RANDOM_ACCESS {
+            PageIterator previous = *this;
+            --*this;
+            return previous;
+        }
+
+        PageIterator& operator+=(difference_type offset) requires IS_RANDOM_ACCESS {
+            page_index_ += offset;
+            page_begin_ = paginator_->GetPageBegin(page_index_);
+            return *this;
+        }
+
+        PageIterator& operator-=(difference_type offset) requires IS_RANDOM_ACCESS {
+            return *this += -offset;
+        }
+
+        PageIterator operator+(difference_type offset) const requires IS_RANDOM_ACCESS {
+            PageIterator result = *this;
+            return result += offset;
+        }
+
+        friend PageIterator operator+(difference_type offset, const PageIterator& it) requires IS_RANDOM_ACCESS {
+            return it + offset;
+        }
+
+        PageIterator operator-(difference_type offset) const requires IS_RANDOM_ACCESS {
+            PageIterator result = *this;
+            return result -= offset;
+        }
+
+        difference_type operator-(const PageIterator& other) const requires IS_RANDOM_ACCESS {
+            return static_cast<difference_type>(page_index_) - static_cast<difference_type>(other.page_index_);
+        }
+
+        Page operator[](difference_type offset) const requires IS_RANDOM_ACCESS {
+            return *(*this + offset);
+        }
+
+        auto operator<=>(const PageIterator& other) const requires IS_RANDOM_ACCESS {
+            return page_index_ <=> other.page_index_;
         }
+
+    private:
+        const Paginator* paginator_ = nullptr;
+        size_t page_index_ = 0;
+        Iterator page_begin_;
+    };
+
+    // std::distance is the only pass over a non-random-access range
+    Paginator(Iterator begin, Iterator end, size_t page_size)
+        : begin_(begin)
+        , end_(end)
+        , page_size_(page_size)
+        , item_count_(static_cast<size_t>(std::distance(begin, end))) {
+        if(page_size == 0) {
+            throw std::invalid_argument("page size can't be 0!");
+        }
+    }
+
+    PageIterator begin() const { return PageIterator(this, 0, begin_); }
+    PageIterator end() const { return PageIterator(this, size(), end_); }
+    size_t size() const { return (item_count_ + page_size_ - 1) / page_size_; }
+
+    // O(1) for random-access iterators, walks the preceding pages otherwise
+    Page operator[](size_t page_index) const {
+        const Iterator page_begin = GetPageBegin(page_index);
+        return Page(page_begin, GetPageEnd(page_index, page_begin));
+    }
+
+private:
+    Iterator GetPageBegin(size_t page_index) const {
+        return std::next(begin_, static_cast<std::ptrdiff_t>(std::min(page_index * page_size_, item_count_)));
     }
 
-    auto begin() const { return pages_.begin(); }
-    auto end() const { return pages_.end(); }
-    size_t size() const { return pages_.size(); }
+    Iterator GetPageEnd(size_t page_index, Iterator page_begin) const {
+        const size_t page_item_count = std::min(page_size_, item_count_ - std::min(page_index * page_size_, item_count_));
+        return std::next(page_begin, static_cast<std::ptrdiff_t>(page_item_count));
+    }
 };
 
 template <typename Container>
@@ -48,6 +169,79 @@ auto Paginate(const Container& c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
 }
 
+// Pages of a source that produces any slice of its results on demand, such
+// as SearchServer::FindTopDocuments with a limit and an offset. Page n is
+// fetched when it is read, without producing pages 0..n-1. The number of
+// pages isn't known in advance, iteration stops after the first short page.
+template <typename PageSource>
+class StreamPaginator {
+public:
+    using Page = std::invoke_result_t<const PageSource&, size_t, size_t>;
+
+    class PageIterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Page;
+        using difference_type = std::ptrdiff_t;
+
+        PageIterator() = default;
+
+        PageIterator(const StreamPaginator* paginator, size_t page_index)
+            : paginator_(paginator), page_index_(page_index), page_((*paginator)[page_index]) {}
+
+        const Page& operator*() const { return page_; }
+        const Page* operator->() const { return &page_; }
+
+        PageIterator& operator++() {
+            ++page_index_;
+            if(page_.size() < paginator_->page_size_) {
+                page_ = Page();
+            } else {
+                page_ = (*paginator_)[page_index_];
+            }
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        bool operator==(std::default_sentinel_t) const {
+            return page_.empty();
+        }
+
+    private:
+        const StreamPaginator* paginator_ = nullptr;
+        size_t page_index_ = 0;
+        Page page_;
+    };
+
+    StreamPaginator(PageSource source, size_t page_size)
+        : source_(std::move(source)), page_size_(page_size) {
+        if(page_size == 0) {
+            throw std::invalid_argument("page size can't be 0!");
+        }
+    }
+
+    PageIterator begin() const { return PageIterator(this, 0); }
+    std::default_sentinel_t end() const { return std::default_sentinel; }
+
+    // empty past the last page
+    Page operator[](size_t page_index) const {
+        return source_(page_index * page_size_, page_size_);
+    }
+
+private:
+    PageSource source_;
+    size_t page_size_;
+};
+
+// source(offset, limit) returns the results [offset, offset + limit)
+template <typename PageSource>
+auto PaginateStream(PageSource source, size_t page_size) {
+    return StreamPaginator<PageSource>(std::move(source), page_size);
+}
+
 template <typename Iterator>
 std::ostream& operator<<(std::ostream& out, const IteratorRange<Iterator>& iter_range) {
     for(const auto& obj : iter_range) {
@@ -0,0 +1,156 @@
+#include "posting_list.h"
+#include <algorithm>
+
+namespace {
+    void WriteVarint(std::vector<uint8_t>& bytes, uint32_t value) {
+        while(value >= 0x80) {
+            bytes.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint32_t ReadVarint(const uint8_t*& position) {
+        uint32_t value = 0;
+        for(int shift = 0;; shift += 7) {
+            const uint8_t byte = *position++;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if(!(byte & 0x80)) {
+                return value;
+            }
+        }
+    }
+}
+
+void PostingList::Append(uint32_t ordinal, uint32_t count, double tf) {
+    const uint32_t previous_ordinal = size_ == 0 ? 0 : blocks_.back().last_ordinal_;
+    if(size_ % BLOCK_SIZE == 0) {
+        blocks_.push_back({ordinal, static_cast<uint32_t>(bytes_.size()), tf});
+    }
+    if(size_ == 0) {
+        first_ordinal_ = ordinal;
+    }
+
+    // the first gap of a block is taken from the previous block's last ordinal
+    WriteVarint(bytes_, ordinal - previous_ordinal);
+    WriteVarint(bytes_, count);
+
+    BlockHeader& block = blocks_.back();
+    block.last_ordinal_ = ordinal;
+    block.max_tf_ = std::max(block.max_tf_, tf);
+    max_tf_ = std::max(max_tf_, tf);
+    ++size_;
+}
+
+size_t PostingList::size() const noexcept {
+    return size_;
+}
+
+bool PostingList::empty() const noexcept {
+    return size_ == 0;
+}
+
+uint32_t PostingList::GetFirstOrdinal() const noexcept {
+    return first_ordinal_;
+}
+
+uint32_t PostingList::GetLastOrdinal() const noexcept {
+    return blocks_.empty() ? 0 : blocks_.back().last_ordinal_;
+}
+
+double PostingList::GetMaxTf() const noexcept {
+    return max_tf_;
+}
+
+size_t PostingList::GetBlockCount() const noexcept {
+    return blocks_.size();
+}
+
+const PostingList::BlockHeader& PostingList::GetBlock(size_t block_index) const {
+    return blocks_[block_index];
+}
+
+size_t PostingList::GetBlockSize(size_t block_index) const {
+    return block_index + 1 < blocks_.size() ? BLOCK_SIZE : size_ - block_index * BLOCK_SIZE;
+}
+
+size_t PostingList::DecodeBlock(size_t block_index, uint32_t* ordinals, uint32_t* counts) const {
+    const size_t block_size = GetBlockSize(block_index);
+    const uint8_t* position = bytes_.data() + blocks_[block_index].offset_;
+    uint32_t ordinal = block_index == 0 ? 0 : blocks_[block_index - 1].last_ordinal_;
+    for(size_t i = 0; i < block_size; ++i) {
+        ordinal += ReadVarint(position);
+        ordinals[i] = ordinal;
+        counts[i] = ReadVarint(position);
+    }
+    return block_size;
+}
+
+size_t PostingList::GetMemoryUsage() const noexcept {
+    return blocks_.capacity() * sizeof(BlockHeader) + bytes_.capacity();
+}
+
+void PostingList::ShrinkToFit() {
+    blocks_.shrink_to_fit();
+    bytes_.shrink_to_fit();
+}
+
+PostingCursor::PostingCursor(const PostingList& postings)
+    : postings_(&postings) {
+    if(!postings.empty()) {
+        LoadBlock();
+    }
+}
+
+bool PostingCursor::IsEnd() const noexcept {
+    return block_index_ >= postings_->GetBlockCount();
+}
+
+uint32_t PostingCursor::GetOrdinal() const {
+    return ordinals_[position_];
+}
+
+uint32_t PostingCursor::GetCount() const {
+    return counts_[position_];
+}
+
+void PostingCursor::Next() {
+    if(++position_ < block_size_) {
+        return;
+    }
+    ++block_index_;
+    is_block_loaded_ = false;
+    if(!IsEnd()) {
+        LoadBlock();
+    }
+}
+
+void PostingCursor::ShallowSeekTo(uint32_t target) {
+    while(!IsEnd() && postings_->GetBlock(block_index_).last_ordinal_ < target) {
+        ++block_index_;
+        is_block_loaded_ = false;
+    }
+}
+
+double PostingCursor::GetBlockMaxTf() const {
+    return postings_->GetBlock(block_index_).max_tf_;
+}
+
+void PostingCursor::SeekTo(uint32_t target) {
+    ShallowSeekTo(target);
+    if(IsEnd()) {
+        return;
+    }
+    if(!is_block_loaded_) {
+        LoadBlock();
+    }
+    // the block's last ordinal is at least target, so this stays inside it
+    position_ = std::lower_bound(ordinals_.begin() + position_, ordinals_.begin() + block_size_, target)
+                - ordinals_.begin();
+}
+
+void PostingCursor::LoadBlock() {
+    block_size_ = postings_->DecodeBlock(block_index_, ordinals_.data(), counts_.data());
+    position_ = 0;
+    is_block_loaded_ = true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Postings of one term: ascending document ordinals with the number of
+// times the term occurs in each. They are packed into blocks of BLOCK_SIZE
+// varint (ordinal gap, count) pairs. Every block has a plain header, so
+// readers skip blocks by their last ordinal and bound scores by their
+// largest tf without decoding them.
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    struct BlockHeader {
+        uint32_t last_ordinal_;
+        uint32_t offset_;
+        double max_tf_;
+    };
+
+    // ordinal must be larger than every ordinal already in the list
+    void Append(uint32_t ordinal, uint32_t count, double tf);
+
+    size_t size() const noexcept;
+    bool empty() const noexcept;
+    uint32_t GetFirstOrdinal() const noexcept;
+    uint32_t GetLastOrdinal() const noexcept;
+    double GetMaxTf() const noexcept;
+
+    size_t GetBlockCount() const noexcept;
+    const BlockHeader& GetBlock(size_t block_index) const;
+    size_t GetBlockSize(size_t block_index) const;
+
+    // Writes the ordinals and counts of a block, returns how many there are.
+    size_t DecodeBlock(size_t block_index, uint32_t* ordinals, uint32_t* counts) const;
+
+    // bytes taken by the headers and the encoded postings
+    size_t GetMemoryUsage() const noexcept;
+
+    void ShrinkToFit();
+
+private:
+    std::vector<BlockHeader> blocks_;
+    std::vector<uint8_t> bytes_;
+    uint32_t size_ = 0;
+    uint32_t first_ordinal_ = 0;
+    double max_tf_ = 0.0;
+};
+
+// Forward-only reader of a PostingList that decodes one block at a time.
+class PostingCursor {
+public:
+    explicit PostingCursor(const PostingList& postings);
+
+    bool IsEnd() const noexcept;
+    uint32_t GetOrdinal() const;
+    uint32_t GetCount() const;
+    void Next();
+
+    // Moves to the block that may hold target by its headers only, so
+    // GetBlockMaxTf bounds target's tf without decoding anything.
+    void ShallowSeekTo(uint32_t target);
+    double GetBlockMaxTf() const;
+
+    // Moves to the first posting with an ordinal of at least target.
+    void SeekTo(uint32_t target);
+
+private:
+    const PostingList* postings_;
+    size_t block_index_ = 0;
+    bool is_block_loaded_ = false;
+    size_t position_ = 0;
+    size_t block_size_ = 0;
+    std::array<uint32_t, PostingList::BLOCK_SIZE> ordinals_;
+    std::array<uint32_t, PostingList::BLOCK_SIZE> counts_;
+
+    void LoadBlock();
+};
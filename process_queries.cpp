@@ -1,41 +1,74 @@
 #include "process_queries.h"
 #include <algorithm>
-#include <execution>
+#include <iterator>
+#include <span>
+#include <stdexcept>
 
 std::vector<std::vector<SearchServer::Document>> ProcessQueries(
         const SearchServer& search_server,
         const std::vector<std::string>& queries) {
-    std::vector<std::vector<SearchServer::Document>> query_results(queries.size());
-
-    std::transform(
-        std::execution::par,
-        queries.begin(), queries.end(),
-        query_results.begin(),
-        [&search_server](const std::string& query) {
-            return search_server.FindTopDocuments(query);
+    return search_server.FindTopDocumentsBatch(queries);
+}
+
+namespace {
+    std::vector<SearchServer::Document> JoinQueryResults(
+            std::vector<std::vector<SearchServer::Document>> documents_by_queries) {
+        size_t size_to_reserve = 0;
+        for(const auto& vector : documents_by_queries) {
+            size_to_reserve += vector.size();
+        }
+
+        std::vector<SearchServer::Document> results_joined;
+        results_joined.reserve(size_to_reserve);
+
+        for(auto& vector : documents_by_queries) {
+            std::move(vector.begin(), vector.end(), std::back_inserter(results_joined));
         }
-    );
-    return query_results;
+
+        return results_joined;
+    }
 }
 
 std::vector<SearchServer::Document> ProcessQueriesJoined(
         const SearchServer& search_server,
         const std::vector<std::string>& queries) {
-    std::vector<std::vector<SearchServer::Document>> documents_by_queries = ProcessQueries(search_server, queries);
-
-    size_t size_to_reserve = 0;
-    for(const auto& vector : documents_by_queries) {
-        size_to_reserve += vector.size();
-    }
+    return JoinQueryResults(ProcessQueries(search_server, queries));
+}
 
+std::vector<std::vector<SearchServer::Document>> ProcessQueries(
+        QueryExecutor& executor,
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries) {
+    return search_server.FindTopDocumentsBatch(executor, queries);
+}
 
-    std::vector<SearchServer::Document> results_joined;
-    results_joined.reserve(size_to_reserve);
+std::vector<SearchServer::Document> ProcessQueriesJoined(
+        QueryExecutor& executor,
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries) {
+    return JoinQueryResults(ProcessQueries(executor, search_server, queries));
+}
 
-    for(auto& vector : documents_by_queries) {
-        std::move(vector.begin(), vector.end(), std::back_inserter(results_joined));
+void ProcessQueriesJoined(
+        QueryExecutor& executor,
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries,
+        const std::function<void(size_t, const SearchServer::Document&)>& consumer,
+        size_t reorder_window) {
+    if(reorder_window == 0) {
+        throw std::invalid_argument("reorder window can't be 0"s);
     }
 
-    return results_joined;
-
-}
\ No newline at end of file
+    // every window is a batch of its own, the workers never wait for the
+    // consumer and only this thread hands out the results
+    const std::span<const std::string> all_queries(queries);
+    for(size_t begin = 0; begin < all_queries.size(); begin += reorder_window) {
+        const std::span<const std::string> window = all_queries.subspan(begin, std::min(reorder_window, all_queries.size() - begin));
+        const std::vector<std::vector<SearchServer::Document>> documents_by_queries = search_server.FindTopDocumentsBatch(executor, window);
+        for(size_t i = 0; i < documents_by_queries.size(); ++i) {
+            for(const SearchServer::Document& document : documents_by_queries[i]) {
+                consumer(begin + i, document);
+            }
+        }
+    }
+}
@@ -1,12 +1,40 @@
 #pragma once
+#include "query_executor.h"
 #include "search_server.h"
+#include <functional>
 #include <vector>
 #include <string>
 
+// Runs the batch through SearchServer::FindTopDocumentsBatch, so queries
+// sharing words share their lookups and postings.
 std::vector<std::vector<SearchServer::Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
 std::vector<SearchServer::Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries);
+
+// The same with the batch run on the workers of executor, which keep their
+// search scratch state from one query to the next.
+std::vector<std::vector<SearchServer::Document>> ProcessQueries(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+std::vector<SearchServer::Document> ProcessQueriesJoined(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Hands every document to consumer(query_index, document) in the order of
+// ProcessQueriesJoined. The queries run as batches of reorder_window on
+// the executor, and each batch is handed out once it is done, so at most
+// reorder_window results are held at a time. consumer is called on the
+// calling thread.
+void ProcessQueriesJoined(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    const std::function<void(size_t, const SearchServer::Document&)>& consumer,
+    size_t reorder_window = 64);
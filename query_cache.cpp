@@ -0,0 +1,80 @@
+#include "query_cache.h"
+
+QueryCache::QueryCache(const SearchServer& search_server, size_t memory_limit)
+    : search_server_(search_server)
+    , memory_limit_(memory_limit)
+    , cached_version_(search_server.GetVersion())
+{}
+
+std::vector<SearchServer::Document> QueryCache::FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status) {
+    std::string key = search_server_.GetNormalizedQuery(raw_query);
+    key += static_cast<char>('0' + static_cast<int>(status));
+
+    {
+        std::lock_guard lock(mutex_);
+        if(cached_version_ != search_server_.GetVersion()) {
+            Clear();
+            cached_version_ = search_server_.GetVersion();
+        }
+        if(auto it = key_to_entry_.find(key); it != key_to_entry_.end()) {
+            ++statistics_.hits_;
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->results_;
+        }
+        ++statistics_.misses_;
+    }
+
+    // the search runs without the lock, so concurrent misses don't wait for each other
+    std::vector<SearchServer::Document> results = search_server_.FindTopDocuments(raw_query, status);
+
+    std::lock_guard lock(mutex_);
+    if(cached_version_ == search_server_.GetVersion() && !key_to_entry_.contains(key)) {
+        Insert(std::move(key), results);
+    }
+    return results;
+}
+
+std::vector<SearchServer::Document> QueryCache::FindTopDocuments(std::string_view raw_query) {
+    return FindTopDocuments(raw_query, SearchServer::DocumentStatus::ACTUAL);
+}
+
+QueryCache::Statistics QueryCache::GetStatistics() const {
+    std::lock_guard lock(mutex_);
+    return statistics_;
+}
+
+size_t QueryCache::GetEntrySize(const Entry& entry) {
+    // list node, hash table node and the heap blocks of the key and results
+    return sizeof(Entry) + 4 * sizeof(void*) + entry.key_.capacity() 
+        + entry.results_.capacity() * sizeof(SearchServer::Document);
+}
+
+void QueryCache::Clear() {
+    key_to_entry_.clear();
+    entries_.clear();
+    statistics_.memory_used_ = 0;
+    statistics_.entry_count_ = 0;
+}
+
+void QueryCache::Insert(std::string&& key, const std::vector<SearchServer::Document>& results) {
+    entries_.push_front({std::move(key), results});
+    Entry& entry = entries_.front();
+    size_t entry_size = GetEntrySize(entry);
+    if(entry_size > memory_limit_) {
+        entries_.pop_front();
+        return;
+    }
+
+    key_to_entry_.emplace(entry.key_, entries_.begin());
+    statistics_.memory_used_ += entry_size;
+    ++statistics_.entry_count_;
+
+    while(statistics_.memory_used_ > memory_limit_) {
+        const Entry& oldest = entries_.back();
+        statistics_.memory_used_ -= GetEntrySize(oldest);
+        --statistics_.entry_count_;
+        ++statistics_.evictions_;
+        key_to_entry_.erase(oldest.key_);
+        entries_.pop_back();
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "search_server.h"
+
+// LRU cache of FindTopDocuments results keyed by the normalized query and
+// the requested status. All entries are dropped as soon as the server
+// version changes, so the cache never returns results of an older index.
+// Queries with an arbitrary predicate can't be compared and bypass it.
+class QueryCache {
+public:
+    struct Statistics {
+        uint64_t hits_ = 0;
+        uint64_t misses_ = 0;
+        uint64_t evictions_ = 0;
+        size_t memory_used_ = 0;
+        size_t entry_count_ = 0;
+    };
+
+    QueryCache(const SearchServer& search_server, size_t memory_limit);
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+
+    template <typename DocumentPredicate>
+    std::vector<SearchServer::Document> FindTopDocuments(
+            std::string_view raw_query, DocumentPredicate document_predicate) const {
+        return search_server_.FindTopDocuments(raw_query, document_predicate);
+    }
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status);
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query);
+
+    Statistics GetStatistics() const;
+
+private:
+    struct Entry {
+        std::string key_;
+        std::vector<SearchServer::Document> results_;
+    };
+
+    const SearchServer& search_server_;
+    const size_t memory_limit_;
+
+    mutable std::mutex mutex_;
+    // most recently used entries first
+    std::list<Entry> entries_;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> key_to_entry_;
+    uint64_t cached_version_ = 0;
+    Statistics statistics_;
+
+    static size_t GetEntrySize(const Entry& entry);
+
+    void Clear();
+
+    void Insert(std::string&& key, const std::vector<SearchServer::Document>& results);
+};
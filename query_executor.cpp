@@ -0,0 +1,208 @@
+#include "query_executor.h"
+#include <algorithm>
+#include <exception>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct QueryExecutor::Job {
+    const std::function<void(size_t)>* task_;
+    std::mutex mutex_;
+    std::condition_variable is_done_;
+    size_t remaining_chunk_count_ = 0;
+    std::exception_ptr exception_;
+    std::atomic<bool> is_failed_ = false;
+};
+
+QueryExecutor::QueryExecutor(size_t worker_count, bool pin_workers) {
+    worker_count = std::max<size_t>(worker_count, 1);
+    workers_.reserve(worker_count);
+    for(size_t i = 0; i < worker_count; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    threads_.reserve(worker_count);
+    for(size_t i = 0; i < worker_count; ++i) {
+        threads_.emplace_back([this, i] {
+            RunWorker(i);
+        });
+        if(pin_workers) {
+            PinWorker(i);
+        }
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        std::lock_guard lock(mutex_);
+        is_stopping_ = true;
+    }
+    has_chunks_.notify_all();
+    for(std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+size_t QueryExecutor::GetWorkerCount() const noexcept {
+    return workers_.size();
+}
+
+void QueryExecutor::ParallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if(count == 0) {
+        return;
+    }
+    const size_t chunk_size = std::max<size_t>(1, count / (workers_.size() * CHUNKS_PER_WORKER));
+    Job job;
+    job.task_ = &task;
+    job.remaining_chunk_count_ = (count + chunk_size - 1) / chunk_size;
+
+    {
+        std::lock_guard lock(mutex_);
+        // counted first, so a worker never sees the count below the chunks it can take
+        queued_chunk_count_ += job.remaining_chunk_count_;
+        size_t worker_index = 0;
+        for(size_t begin = 0; begin < count; begin += chunk_size) {
+            Worker& worker = *workers_[worker_index];
+            {
+                std::lock_guard worker_lock(worker.mutex_);
+                worker.chunks_.push_back({&job, begin, std::min(count, begin + chunk_size)});
+            }
+            worker_index = (worker_index + 1) % workers_.size();
+        }
+    }
+    has_chunks_.notify_all();
+
+    // help instead of blocking a thread, the chunks may be queued behind
+    // the caller's own if it is a worker
+    while(TryRunChunk(NO_WORKER)) {
+        std::lock_guard lock(job.mutex_);
+        if(job.remaining_chunk_count_ == 0) {
+            break;
+        }
+    }
+    {
+        std::unique_lock lock(job.mutex_);
+        job.is_done_.wait(lock, [&job] {
+            return job.remaining_chunk_count_ == 0;
+        });
+    }
+    if(job.exception_) {
+        std::rethrow_exception(job.exception_);
+    }
+}
+
+std::vector<QueryExecutor::WorkerStatistics> QueryExecutor::GetWorkerStatistics() const {
+    const auto lifetime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time_);
+    auto get_statistics = [&lifetime](const Worker& worker) {
+        WorkerStatistics worker_statistics;
+        worker_statistics.task_count_ = worker.task_count_.load(std::memory_order_relaxed);
+        worker_statistics.stolen_chunk_count_ = worker.stolen_chunk_count_.load(std::memory_order_relaxed);
+        worker_statistics.busy_time_ = std::chrono::nanoseconds(worker.busy_nanoseconds_.load(std::memory_order_relaxed));
+        worker_statistics.utilization_ = lifetime.count() > 0
+            ? std::min(1.0, static_cast<double>(worker_statistics.busy_time_.count()) / lifetime.count())
+            : 0.0;
+        return worker_statistics;
+    };
+    std::vector<WorkerStatistics> statistics;
+    statistics.reserve(workers_.size() + 1);
+    for(const auto& worker : workers_) {
+        statistics.push_back(get_statistics(*worker));
+    }
+    statistics.push_back(get_statistics(caller_));
+    return statistics;
+}
+
+void QueryExecutor::RunWorker(size_t worker_index) {
+    while(true) {
+        if(TryRunChunk(worker_index)) {
+            continue;
+        }
+        std::unique_lock lock(mutex_);
+        has_chunks_.wait(lock, [this] {
+            return is_stopping_ || queued_chunk_count_ > 0;
+        });
+        if(is_stopping_) {
+            return;
+        }
+    }
+}
+
+std::optional<QueryExecutor::Chunk> QueryExecutor::TakeChunk(size_t worker_index, bool& is_stolen) {
+    if(worker_index != NO_WORKER) {
+        Worker& worker = *workers_[worker_index];
+        std::lock_guard lock(worker.mutex_);
+        if(!worker.chunks_.empty()) {
+            const Chunk chunk = worker.chunks_.back();
+            worker.chunks_.pop_back();
+            --queued_chunk_count_;
+            is_stolen = false;
+            return chunk;
+        }
+    }
+    const size_t first_victim = worker_index == NO_WORKER ? 0 : worker_index + 1;
+    for(size_t i = 0; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[(first_victim + i) % workers_.size()];
+        std::lock_guard lock(victim.mutex_);
+        if(!victim.chunks_.empty()) {
+            const Chunk chunk = victim.chunks_.front();
+            victim.chunks_.pop_front();
+            --queued_chunk_count_;
+            is_stolen = true;
+            return chunk;
+        }
+    }
+    return std::nullopt;
+}
+
+bool QueryExecutor::TryRunChunk(size_t worker_index) {
+    if(queued_chunk_count_ == 0) {
+        return false;
+    }
+    bool is_stolen = false;
+    const std::optional<Chunk> chunk = TakeChunk(worker_index, is_stolen);
+    if(!chunk) {
+        return false;
+    }
+
+    Job& job = *chunk->job_;
+    const auto start_time = std::chrono::steady_clock::now();
+    if(!job.is_failed_) {
+        try {
+            for(size_t i = chunk->begin_; i < chunk->end_; ++i) {
+                (*job.task_)(i);
+            }
+        } catch(...) {
+            std::lock_guard lock(job.mutex_);
+            if(!job.exception_) {
+                job.exception_ = std::current_exception();
+            }
+            job.is_failed_ = true;
+        }
+    }
+    Worker& worker = worker_index == NO_WORKER ? caller_ : *workers_[worker_index];
+    worker.task_count_.fetch_add(chunk->end_ - chunk->begin_, std::memory_order_relaxed);
+    worker.stolen_chunk_count_.fetch_add(is_stolen ? 1 : 0, std::memory_order_relaxed);
+    worker.busy_nanoseconds_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_time).count(), std::memory_order_relaxed);
+
+    // the caller may free the job as soon as the count drops to zero, so
+    // the job isn't touched after the lock is released
+    std::lock_guard lock(job.mutex_);
+    if(--job.remaining_chunk_count_ == 0) {
+        job.is_done_.notify_all();
+    }
+    return true;
+}
+
+void QueryExecutor::PinWorker(size_t worker_index) {
+#ifdef __linux__
+    const unsigned cpu_count = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(worker_index % cpu_count, &cpu_set);
+    pthread_setaffinity_np(threads_[worker_index].native_handle(), sizeof(cpu_set), &cpu_set);
+#else
+    (void)worker_index;
+#endif
+}
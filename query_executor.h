@@ -0,0 +1,89 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Long-lived pool of worker threads with work stealing. A ParallelFor is cut
+// into chunks spread over the workers' deques; a worker takes chunks from
+// the back of its own deque and steals from the front of the others' once
+// it runs dry. Threads outlive the calls, so per-thread scratch state of
+// the search (score accumulators, cursors) is reused from query to query.
+class QueryExecutor {
+public:
+    struct WorkerStatistics {
+        uint64_t task_count_ = 0;
+        uint64_t stolen_chunk_count_ = 0;
+        std::chrono::nanoseconds busy_time_{0};
+        // busy_time_ over the lifetime of the executor
+        double utilization_ = 0.0;
+    };
+
+    // Workers are pinned to CPUs worker_index % CPU count if pin_workers is
+    // set and the platform supports it.
+    explicit QueryExecutor(size_t worker_count = std::max(1u, std::thread::hardware_concurrency()),
+                           bool pin_workers = false);
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+    ~QueryExecutor();
+
+    size_t GetWorkerCount() const noexcept;
+
+    // Runs task(i) for every i in [0, count) and returns when all are done.
+    // The calling thread runs chunks too, so ParallelFor may be nested. The
+    // first exception thrown by a task is rethrown, the chunks not yet
+    // started are skipped.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    // One row per worker, then one more for the chunks run by the threads
+    // calling ParallelFor, summed over all of them.
+    std::vector<WorkerStatistics> GetWorkerStatistics() const;
+
+private:
+    static constexpr size_t NO_WORKER = static_cast<size_t>(-1);
+    // chunks per worker, more of them balance better and cost more locking
+    static constexpr size_t CHUNKS_PER_WORKER = 8;
+
+    struct Job;
+
+    struct Chunk {
+        Job* job_;
+        size_t begin_;
+        size_t end_;
+    };
+
+    struct alignas(64) Worker {
+        std::mutex mutex_;
+        std::deque<Chunk> chunks_;
+        std::atomic<uint64_t> task_count_ = 0;
+        std::atomic<uint64_t> stolen_chunk_count_ = 0;
+        std::atomic<int64_t> busy_nanoseconds_ = 0;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    // statistics of the chunks run by callers, its deque stays empty
+    Worker caller_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable has_chunks_;
+    std::atomic<size_t> queued_chunk_count_ = 0;
+    bool is_stopping_ = false;
+    const std::chrono::steady_clock::time_point start_time_ = std::chrono::steady_clock::now();
+
+    void RunWorker(size_t worker_index);
+
+    // own deque first, then the others, worker_index is NO_WORKER for callers
+    std::optional<Chunk> TakeChunk(size_t worker_index, bool& is_stolen);
+
+    bool TryRunChunk(size_t worker_index);
+
+    void PinWorker(size_t worker_index);
+};
@@ -4,14 +4,23 @@ RequestQueue::RequestQueue(const SearchServer& search_server)
     : search_server_(search_server) 
 {}
 
+RequestQueue::RequestQueue(const SearchServer& search_server, QueryCache& query_cache)
+    : search_server_(search_server) 
+    , query_cache_(&query_cache)
+{}
+
 std::vector<SearchServer::Document> RequestQueue::AddFindRequest(const std::string& raw_query, SearchServer::DocumentStatus status) {
-    QueryResult query_result = std::move(search_server_.FindTopDocuments(raw_query, status));
+    QueryResult query_result = query_cache_ != nullptr
+        ? query_cache_->FindTopDocuments(raw_query, status)
+        : search_server_.FindTopDocuments(raw_query, status);
     AddQueryResult(std::move(query_result));
     return requests_.front().results_;
 }
 
 std::vector<SearchServer::Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
-    QueryResult query_result = std::move(search_server_.FindTopDocuments(raw_query));
+    QueryResult query_result = query_cache_ != nullptr
+        ? query_cache_->FindTopDocuments(raw_query)
+        : search_server_.FindTopDocuments(raw_query);
     AddQueryResult(std::move(query_result));
     return requests_.front().results_;
 }
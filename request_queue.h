@@ -1,10 +1,13 @@
 #pragma once
 #include "search_server.h"
+#include "query_cache.h"
 #include <deque>
 
 class RequestQueue {
 public:
     explicit RequestQueue(const SearchServer& search_server);
+    // requests by status are answered through query_cache
+    RequestQueue(const SearchServer& search_server, QueryCache& query_cache);
     RequestQueue(const RequestQueue&) = delete;
     RequestQueue& operator=(const RequestQueue&) = delete;
 
@@ -29,6 +32,7 @@ private:
     const static int min_in_day_ = 1440;
     int empty_requests_count_ = 0;
     const SearchServer& search_server_;
+    QueryCache* query_cache_ = nullptr;
 
     void AddQueryResult(QueryResult&& query_result);
 };
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "scoring_kernel.h"
+#include <atomic>
+#include <bit>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCORING_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    void AccumulateScoresScalar(const uint32_t* ordinals, const double* tfs, size_t count, double idf,
+                                double* scores, uint8_t* matched) {
+        for(size_t i = 0; i < count; ++i) {
+            scores[ordinals[i]] += tfs[i] * idf;
+            matched[ordinals[i]] = 1;
+        }
+    }
+
+    size_t SelectCandidatesScalar(const double* scores, const uint8_t* matched, size_t begin, size_t end,
+                                  double min_score, uint32_t* selected) {
+        size_t count = 0;
+        for(size_t i = begin; i < end; ++i) {
+            if(matched[i] && scores[i] >= min_score) {
+                selected[count++] = static_cast<uint32_t>(i);
+            }
+        }
+        return count;
+    }
+
+#ifdef SCORING_KERNEL_X86
+    __attribute__((target("sse2")))
+    void AccumulateScoresSse2(const uint32_t* ordinals, const double* tfs, size_t count, double idf,
+                              double* scores, uint8_t* matched) {
+        const __m128d idf2 = _mm_set1_pd(idf);
+        size_t i = 0;
+        for(; i + 2 <= count; i += 2) {
+            const uint32_t first = ordinals[i];
+            const uint32_t second = ordinals[i + 1];
+            const __m128d contribution = _mm_mul_pd(_mm_loadu_pd(tfs + i), idf2);
+            const __m128d sum = _mm_add_pd(_mm_set_pd(scores[second], scores[first]), contribution);
+            _mm_storel_pd(scores + first, sum);
+            _mm_storeh_pd(scores + second, sum);
+            matched[first] = 1;
+            matched[second] = 1;
+        }
+        AccumulateScoresScalar(ordinals + i, tfs + i, count - i, idf, scores, matched);
+    }
+
+    __attribute__((target("sse2")))
+    size_t SelectCandidatesSse2(const double* scores, const uint8_t* matched, size_t begin, size_t end,
+                                double min_score, uint32_t* selected) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128d min2 = _mm_set1_pd(min_score);
+        size_t count = 0;
+        size_t i = begin;
+        for(; i + 16 <= end; i += 16) {
+            const __m128i flags = _mm_loadu_si128(reinterpret_cast<const __m128i*>(matched + i));
+            const uint32_t matched_mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(flags, zero))) & 0xFFFF;
+            if(matched_mask == 0) {
+                continue;
+            }
+            for(size_t pair = 0; pair < 8; ++pair) {
+                uint32_t passing = (matched_mask >> (pair * 2)) & 0x3;
+                if(passing == 0) {
+                    continue;
+                }
+                passing &= _mm_movemask_pd(_mm_cmpge_pd(_mm_loadu_pd(scores + i + pair * 2), min2));
+                for(; passing != 0; passing &= passing - 1) {
+                    selected[count++] = static_cast<uint32_t>(i + pair * 2 + std::countr_zero(passing));
+                }
+            }
+        }
+        return count + SelectCandidatesScalar(scores, matched, i, end, min_score, selected + count);
+    }
+
+    __attribute__((target("avx2")))
+    void AccumulateScoresAvx2(const uint32_t* ordinals, const double* tfs, size_t count, double idf,
+                              double* scores, uint8_t* matched) {
+        const __m256d idf4 = _mm256_set1_pd(idf);
+        const __m256d all_lanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4) {
+            const __m128i indexes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ordinals + i));
+            const __m256d contribution = _mm256_mul_pd(_mm256_loadu_pd(tfs + i), idf4);
+            const __m256d sum = _mm256_add_pd(_mm256_mask_i32gather_pd(_mm256_setzero_pd(), scores, indexes, all_lanes, 8), contribution);
+            // AVX2 has no scatter, so the lanes go back one by one
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, sum);
+            for(size_t lane = 0; lane < 4; ++lane) {
+                scores[ordinals[i + lane]] = lanes[lane];
+                matched[ordinals[i + lane]] = 1;
+            }
+        }
+        AccumulateScoresScalar(ordinals + i, tfs + i, count - i, idf, scores, matched);
+    }
+
+    __attribute__((target("avx2")))
+    size_t SelectCandidatesAvx2(const double* scores, const uint8_t* matched, size_t begin, size_t end,
+                                double min_score, uint32_t* selected) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256d min4 = _mm256_set1_pd(min_score);
+        size_t count = 0;
+        size_t i = begin;
+        for(; i + 32 <= end; i += 32) {
+            const __m256i flags = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(matched + i));
+            const uint32_t matched_mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(flags, zero)));
+            if(matched_mask == 0) {
+                continue;
+            }
+            for(size_t quad = 0; quad < 8; ++quad) {
+                uint32_t passing = (matched_mask >> (quad * 4)) & 0xF;
+                if(passing == 0) {
+                    continue;
+                }
+                passing &= _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(scores + i + quad * 4), min4, _CMP_GE_OQ));
+                for(; passing != 0; passing &= passing - 1) {
+                    selected[count++] = static_cast<uint32_t>(i + quad * 4 + std::countr_zero(passing));
+                }
+            }
+        }
+        return count + SelectCandidatesScalar(scores, matched, i, end, min_score, selected + count);
+    }
+#endif
+
+    ScoringKernel DetectScoringKernel() noexcept {
+#ifdef SCORING_KERNEL_X86
+        // runs from a static initializer, possibly before libgcc's own
+        __builtin_cpu_init();
+#endif
+        if(IsScoringKernelSupported(ScoringKernel::AVX2)) {
+            return ScoringKernel::AVX2;
+        }
+        if(IsScoringKernelSupported(ScoringKernel::SSE2)) {
+            return ScoringKernel::SSE2;
+        }
+        return ScoringKernel::SCALAR;
+    }
+
+    std::atomic<ScoringKernel> current_kernel = DetectScoringKernel();
+}
+
+ScoringKernel GetScoringKernel() noexcept {
+    return current_kernel.load(std::memory_order_relaxed);
+}
+
+bool IsScoringKernelSupported(ScoringKernel kernel) noexcept {
+    switch(kernel) {
+#ifdef SCORING_KERNEL_X86
+        case ScoringKernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+        case ScoringKernel::SSE2:
+            return __builtin_cpu_supports("sse2");
+#endif
+        case ScoringKernel::SCALAR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void SetScoringKernel(ScoringKernel kernel) {
+    if(!IsScoringKernelSupported(kernel)) {
+        throw std::invalid_argument("scoring kernel isn't supported by this CPU");
+    }
+    current_kernel.store(kernel, std::memory_order_relaxed);
+}
+
+void AccumulateScores(const uint32_t* ordinals, const double* tfs, size_t count, double idf,
+                      double* scores, uint8_t* matched) {
+    switch(GetScoringKernel()) {
+#ifdef SCORING_KERNEL_X86
+        case ScoringKernel::AVX2:
+            return AccumulateScoresAvx2(ordinals, tfs, count, idf, scores, matched);
+        case ScoringKernel::SSE2:
+            return AccumulateScoresSse2(ordinals, tfs, count, idf, scores, matched);
+#endif
+        default:
+            return AccumulateScoresScalar(ordinals, tfs, count, idf, scores, matched);
+    }
+}
+
+size_t SelectCandidates(const double* scores, const uint8_t* matched, uint32_t begin, uint32_t end,
+                        double min_score, uint32_t* selected) {
+    switch(GetScoringKernel()) {
+#ifdef SCORING_KERNEL_X86
+        case ScoringKernel::AVX2:
+            return SelectCandidatesAvx2(scores, matched, begin, end, min_score, selected);
+        case ScoringKernel::SSE2:
+            return SelectCandidatesSse2(scores, matched, begin, end, min_score, selected);
+#endif
+        default:
+            return SelectCandidatesScalar(scores, matched, begin, end, min_score, selected);
+    }
+}
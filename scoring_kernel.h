@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Term-at-a-time scoring over a dense accumulator indexed by document
+// ordinal. Every kernel has a scalar, an SSE2 and an AVX2 version; the best
+// one the CPU supports is picked at startup and all of them give the same
+// bits, because products and sums are rounded one by one (no FMA).
+enum class ScoringKernel {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+ScoringKernel GetScoringKernel() noexcept;
+
+bool IsScoringKernelSupported(ScoringKernel kernel) noexcept;
+
+// Throws std::invalid_argument if the CPU doesn't support the kernel.
+void SetScoringKernel(ScoringKernel kernel);
+
+// scores[ordinals[i]] += tfs[i] * idf and matched[ordinals[i]] = 1. The
+// ordinals of one call must be distinct and below 2^31.
+void AccumulateScores(const uint32_t* ordinals, const double* tfs, size_t count, double idf,
+                      double* scores, uint8_t* matched);
+
+// Writes to selected every ordinal in [begin, end) that is matched and has
+// a score of at least min_score, returns how many were written.
+size_t SelectCandidates(const double* scores, const uint8_t* matched, uint32_t begin, uint32_t end,
+                        double min_score, uint32_t* selected);
@@ -1,66 +1,211 @@
 #include "search_server.h"
+#include "scoring_kernel.h"
+#include <bit>
+#include <charconv>
 #include <cmath>
+#include <memory>
+#include <exception>
+#include <numeric>
+#include <compare>
+#include <cstdint>
+#include <tuple>
 
 SearchServer::Document::Document() 
-    : rating_(0)
+    : id_(0)
+    , rating_(0)
     , relevance_(0.0)
     , status_(DocumentStatus::ACTUAL) {}
 
 SearchServer::Document::Document(int id, int rating, DocumentStatus status)
     : id_(id)
     , rating_(rating)
+    , relevance_(0.0)
     , status_(status) {}
 
 SearchServer::SearchServer(const std::string& stop_words_text) {   
-    std::vector<std::string> stop_words_vector = SplitIntoWords(stop_words_text);
+    ForEachWord(stop_words_text, [this](std::string_view word) {
+        stop_words_.emplace(word);
+    });
+}
 
-    for(auto& word : stop_words_vector) {
-        CheckUnacceptableSymbols(word);
-        stop_words_.insert(std::move(word));
+void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    CheckNewDocumentId(document_id);
+    InsertDocument(document_id, status, ParseDocument(document, ratings));
+}
+
+void SearchServer::AddDocuments(std::span<const DocumentInput> documents) {
+    std::vector<int> new_ids;
+    new_ids.reserve(documents.size());
+    for(const DocumentInput& document : documents) {
+        CheckNewDocumentId(document.id_);
+        new_ids.push_back(document.id_);
+    }
+    std::sort(new_ids.begin(), new_ids.end());
+    if(std::adjacent_find(new_ids.begin(), new_ids.end()) != new_ids.end()) {
+        throw std::invalid_argument("document already exists!");
+    }
+
+    // exceptions must not escape a parallel algorithm, so they are
+    // collected and rethrown once every document has been tokenized
+    std::vector<ParsedDocument> parsed_documents(documents.size());
+    std::vector<std::exception_ptr> errors(documents.size());
+    std::vector<size_t> indexes(documents.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), 
+        [&](size_t i) {
+            try {
+                parsed_documents[i] = ParseDocument(documents[i].text_, documents[i].ratings_);
+            } catch(...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    for(const std::exception_ptr& error : errors) {
+        if(error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    for(size_t i = 0; i < documents.size(); ++i) {
+        InsertDocument(documents[i].id_, documents[i].status_, parsed_documents[i]);
     }
 }
 
-void SearchServer::AddDocument(int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings) {
+void SearchServer::CheckNewDocumentId(int document_id) const {
     if(document_id < 0) {
         throw std::invalid_argument("document_id can't be less than 0!");
     }
 
-    if(auto it = id_to_document_.find(document_id); it != id_to_document_.end()) {
+    if(auto it = id_to_ordinal_.find(document_id); it != id_to_ordinal_.end()) {
         throw std::invalid_argument("document already exists!");
     }
+}
 
+SearchServer::ParsedDocument SearchServer::ParseDocument(std::string_view document, const std::vector<int>& ratings) const {
+    std::vector<std::string_view> words_no_stop = SplitIntoWordsNoStop(document);
 
-    std::unordered_map<std::string, int> word_to_count;
-    std::vector<std::string> words_no_stop = SplitIntoWordsNoStop(document);
-    for(const auto& word : words_no_stop) {
-        CheckUnacceptableSymbols(word);
+    std::unordered_map<std::string_view, int> word_to_count;
+    for(std::string_view word : words_no_stop) {
         ++word_to_count[word];
     }
-    
-    std::set<std::string> words_no_stop_set(words_no_stop.begin(), words_no_stop.end());
-    for(const auto& word : words_no_stop_set) {
-        ++word_to_count_[word];
-    }
-    
-    int avg_rating = ComputeAverageRating(ratings);
-    id_to_document_.insert({document_id, {document_id, avg_rating, status}});
-    
+
+    ParsedDocument parsed_document;
+    parsed_document.word_counts_.reserve(word_to_count.size());
     for(const auto& [word, count] : word_to_count) {
-        id_to_document_[document_id].word_to_freqs_[word] = static_cast<double>(count) / words_no_stop.size();
+        parsed_document.word_counts_.emplace_back(word, count);
     }
-    
+    parsed_document.length_ = static_cast<uint32_t>(words_no_stop.size());
+    parsed_document.rating_ = ComputeAverageRating(ratings);
+    return parsed_document;
+}
+
+void SearchServer::InsertDocument(int document_id, DocumentStatus status, const ParsedDocument& parsed_document) {
+    const DocumentOrdinal ordinal = static_cast<DocumentOrdinal>(document_ids_.size());
+    id_to_ordinal_.emplace(document_id, ordinal);
+    document_ids_.push_back(document_id);
+    ratings_.push_back(parsed_document.rating_);
+    statuses_.push_back(status);
+    status_to_documents_[static_cast<size_t>(status)].Add(ordinal);
+    document_lengths_.push_back(parsed_document.length_);
+
+    TermCounts& term_counts = ordinal_to_term_counts_.emplace_back();
+    term_counts.reserve(parsed_document.word_counts_.size());
+    for(const auto& [word, count] : parsed_document.word_counts_) {
+        term_counts.emplace_back(terms_.Intern(word), count);
+    }
+    std::sort(term_counts.begin(), term_counts.end());
+
+    if(term_to_postings_.size() < terms_.size()) {
+        term_to_postings_.resize(terms_.size());
+        term_to_removed_posting_count_.resize(terms_.size());
+        term_to_log_document_freq_.resize(terms_.size());
+    }
+    // the new ordinal is the largest one, so it is appended to the last block
+    for(const auto& [term_id, count] : term_counts) {
+        term_to_postings_[term_id].Append(ordinal, count, GetTf(ordinal, count));
+        UpdateLogDocumentFreq(term_id);
+    }
+
     ++document_count_;
+    ++version_;
+    log_document_count_ = std::log(document_count_);
 }
 
-std::vector<SearchServer::Document> SearchServer::FindTopDocuments(const std::string& raw_query, DocumentStatus status) const {
-    auto pred = [status](int id, DocumentStatus s, int r) {
-        return s == status;
-    };
+std::vector<SearchServer::Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, DocumentFilter{.status_ = status});
+}
+
+std::vector<SearchServer::Document> SearchServer::FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter) const {
+    TopDocumentsSearch search;
+    search.filter_ = &filter;
+    return SearchTopDocuments(raw_query, nullptr, std::move(search));
+}
+
+std::vector<SearchServer::Document> SearchServer::FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, 
+        size_t limit, size_t offset) const {
+    if(limit > std::numeric_limits<size_t>::max() - offset) {
+        throw std::invalid_argument("page is out of range"s);
+    }
+    if(limit == 0) {
+        return {};
+    }
+    // the heap keeps the skipped documents too, they are dropped once sorted
+    TopDocumentsSearch search;
+    search.filter_ = &filter;
+    search.limit_ = offset + limit;
+    search.is_more_relevant_ = IsBeforeInPages;
+    std::vector<Document> documents = SearchTopDocuments(raw_query, nullptr, std::move(search));
+    documents.erase(documents.begin(), documents.begin() + std::min(offset, documents.size()));
+    return documents;
+}
+
+std::vector<SearchServer::Document> SearchServer::FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, 
+        size_t limit, const SearchCursor& after) const {
+    if(limit == 0) {
+        return {};
+    }
+    TopDocumentsSearch search;
+    search.filter_ = &filter;
+    search.limit_ = limit;
+    search.is_more_relevant_ = IsBeforeInPages;
+    search.after_ = &after;
+    return SearchTopDocuments(raw_query, nullptr, std::move(search));
+}
 
-    return FindTopDocuments(raw_query, pred);
+SearchServer::SearchCursor SearchServer::SearchCursor::After(const Document& document) {
+    return {document.relevance_, document.rating_, document.id_};
 }
 
-std::vector<SearchServer::Document> SearchServer::FindTopDocuments(const std::string& raw_query) const {
+std::string SearchServer::SearchCursor::ToString() const {
+    // the bits of the relevance, so the next page starts exactly after it
+    std::array<char, 16> relevance_digits;
+    char* relevance_end = std::to_chars(relevance_digits.data(), relevance_digits.data() + relevance_digits.size(), 
+                                        std::bit_cast<uint64_t>(relevance_), 16).ptr;
+    return std::string(relevance_digits.data(), relevance_end) + ':' + std::to_string(rating_) + ':' + std::to_string(id_);
+}
+
+SearchServer::SearchCursor SearchServer::SearchCursor::FromString(std::string_view text) {
+    const char* position = text.data();
+    const char* const end = text.data() + text.size();
+    uint64_t relevance_bits = 0;
+    SearchCursor cursor;
+    auto parse = [&position, end](auto& value, int base, bool is_last) {
+        const auto [next, error] = std::from_chars(position, end, value, base);
+        if(error != std::errc() || (is_last ? next != end : next == end || *next != ':')) {
+            throw std::invalid_argument("invalid search cursor"s);
+        }
+        position = next + 1;
+    };
+    parse(relevance_bits, 16, false);
+    parse(cursor.rating_, 10, false);
+    parse(cursor.id_, 10, true);
+    cursor.relevance_ = std::bit_cast<double>(relevance_bits);
+    if(std::isnan(cursor.relevance_)) {
+        throw std::invalid_argument("invalid search cursor"s);
+    }
+    return cursor;
+}
+
+std::vector<SearchServer::Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
@@ -69,125 +214,777 @@ int SearchServer::GetDocumentCount() const noexcept {
 }
 
 std::tuple<std::vector<std::string>, SearchServer::DocumentStatus> 
-SearchServer::MatchDocument(const std::string& raw_query, int document_id) const {
+SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
     std::vector<std::string> plus_words;
-    SearchServer::Query query_words = ParseQuery(raw_query);
-    const Document& current_document = id_to_document_.at(document_id);
+    SearchServer::Query query_terms = ParseQuery(raw_query);
+    const DocumentOrdinal ordinal = id_to_ordinal_.at(document_id);
+    const DocumentStatus status = statuses_[ordinal];
+    const TermCounts& term_counts = ordinal_to_term_counts_[ordinal];
     
-    for(const auto& mw : query_words.minus_words_) {
-        if(auto it = current_document.word_to_freqs_.find(mw); it != current_document.word_to_freqs_.end()) {
-            return {{}, current_document.status_};
+    for(TermId mt : query_terms.minus_terms_) {
+        if(ContainsTerm(term_counts, mt)) {
+            return {std::vector<std::string>{}, status};
+        }
+    }
+    for(TermId pt : query_terms.plus_terms_) {
+        if(ContainsTerm(term_counts, pt)) {
+            plus_words.emplace_back(terms_.GetTerm(pt));
         }
     }
-    for(auto& pw : query_words.plus_words_) {
-        if(auto it = current_document.word_to_freqs_.find(pw); it != current_document.word_to_freqs_.end()) {
-            plus_words.push_back(std::move(pw));
+    std::sort(plus_words.begin(), plus_words.end());
+    return {plus_words, status};
+}
+
+std::map<std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+    std::map<std::string_view, double> word_freqs;
+    if(auto it = id_to_ordinal_.find(document_id); it != id_to_ordinal_.end()) {
+        for(const auto& [term_id, count] : ordinal_to_term_counts_[it->second]) {
+            word_freqs.emplace(terms_.GetTerm(term_id), GetTf(it->second, count));
         }
     }
-    return {plus_words, current_document.status_};
+    return word_freqs;
+}
+
+uint64_t SearchServer::GetVersion() const noexcept {
+    return version_;
+}
+
+std::string SearchServer::GetNormalizedQuery(std::string_view raw_query) const {
+    const Query query_terms = ParseQuery(raw_query);
+    std::string normalized_query;
+    // words of removed documents stay interned, they change no result
+    for(TermId term_id : query_terms.plus_terms_) {
+        if(CountLiveDocuments(term_id) == 0) {
+            continue;
+        }
+        normalized_query += terms_.GetTerm(term_id);
+        normalized_query += ' ';
+    }
+    for(TermId term_id : query_terms.minus_terms_) {
+        if(CountLiveDocuments(term_id) == 0) {
+            continue;
+        }
+        normalized_query += '-';
+        normalized_query += terms_.GetTerm(term_id);
+        normalized_query += ' ';
+    }
+    return normalized_query;
+}
+
+int SearchServer::GetDocumentFrequency(std::string_view word) const {
+    TermId term_id = terms_.Find(word);
+    if(term_id == NO_TERM) {
+        return 0;
+    }
+    return CountLiveDocuments(term_id);
+}
+
+const std::set<std::string, std::less<>>& SearchServer::GetStopWords() const noexcept {
+    return stop_words_;
+}
+
+void SearchServer::CopyDocumentFrom(const SearchServer& source, int document_id) {
+    CheckNewDocumentId(document_id);
+
+    const DocumentOrdinal ordinal = source.id_to_ordinal_.at(document_id);
+    ParsedDocument parsed_document;
+    parsed_document.rating_ = source.ratings_[ordinal];
+    parsed_document.length_ = source.document_lengths_[ordinal];
+    for(const auto& [term_id, count] : source.ordinal_to_term_counts_[ordinal]) {
+        parsed_document.word_counts_.emplace_back(source.terms_.GetTerm(term_id), count);
+    }
+    InsertDocument(document_id, source.statuses_[ordinal], parsed_document);
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    if(auto it = id_to_document_.find(document_id); it != id_to_document_.end()) {
-        for(const auto& [word, _] : it->second.word_to_freqs_) {
-            if(word_to_count_.at(word) == 1) {
-                word_to_count_.erase(word);
-            } else {
-                --word_to_count_[word];
+    RemoveDocuments(std::span<const int>(&document_id, 1));
+}
+
+void SearchServer::RemoveDocuments(std::span<const int> document_ids) {
+    std::vector<TermId> affected_terms;
+    int removed_count = 0;
+
+    for(int document_id : document_ids) {
+        auto it = id_to_ordinal_.find(document_id);
+        if(it == id_to_ordinal_.end()) {
+            continue;
+        }
+        const DocumentOrdinal ordinal = it->second;
+        for(const auto& [term_id, _] : ordinal_to_term_counts_[ordinal]) {
+            affected_terms.push_back(term_id);
+        }
+        TermCounts().swap(ordinal_to_term_counts_[ordinal]);
+        document_ids_[ordinal] = REMOVED_DOCUMENT_ID;
+        status_to_documents_[static_cast<size_t>(statuses_[ordinal])].Remove(ordinal);
+        id_to_ordinal_.erase(it);
+        ++removed_count;
+    }
+
+    if(removed_count == 0) {
+        return;
+    }
+
+    // A list is rebuilt only once most of its postings are removed, so
+    // every rebuild is paid for by the removals before it.
+    for(TermId term_id : affected_terms) {
+        ++term_to_removed_posting_count_[term_id];
+    }
+    std::sort(affected_terms.begin(), affected_terms.end());
+    affected_terms.erase(std::unique(affected_terms.begin(), affected_terms.end()), affected_terms.end());
+    for(TermId term_id : affected_terms) {
+        if(2 * term_to_removed_posting_count_[term_id] > term_to_postings_[term_id].size()) {
+            RebuildPostings(term_id, nullptr);
+        }
+        UpdateLogDocumentFreq(term_id);
+    }
+
+    document_count_ -= removed_count;
+    ++version_;
+    log_document_count_ = document_count_ > 0 ? std::log(document_count_) : 0.0;
+
+    if(document_ids_.size() > 2 * id_to_ordinal_.size() + 64) {
+        CompactOrdinals();
+    }
+}
+
+void SearchServer::CompactOrdinals() {
+    // live documents are renumbered in id order
+    std::vector<DocumentOrdinal> old_to_new(document_ids_.size(), NO_ORDINAL);
+    std::vector<int> document_ids;
+    std::vector<int> ratings;
+    std::vector<DocumentStatus> statuses;
+    std::vector<uint32_t> document_lengths;
+    std::vector<TermCounts> ordinal_to_term_counts;
+    document_ids.reserve(id_to_ordinal_.size());
+    ratings.reserve(id_to_ordinal_.size());
+    statuses.reserve(id_to_ordinal_.size());
+    document_lengths.reserve(id_to_ordinal_.size());
+    ordinal_to_term_counts.reserve(id_to_ordinal_.size());
+    for(DocumentBitmap& documents : status_to_documents_) {
+        documents.Clear();
+    }
+
+    for(auto& [document_id, ordinal] : id_to_ordinal_) {
+        const DocumentOrdinal new_ordinal = static_cast<DocumentOrdinal>(document_ids.size());
+        old_to_new[ordinal] = new_ordinal;
+        document_ids.push_back(document_id);
+        ratings.push_back(ratings_[ordinal]);
+        statuses.push_back(statuses_[ordinal]);
+        document_lengths.push_back(document_lengths_[ordinal]);
+        ordinal_to_term_counts.push_back(std::move(ordinal_to_term_counts_[ordinal]));
+        status_to_documents_[static_cast<size_t>(statuses_[ordinal])].Add(new_ordinal);
+        ordinal = new_ordinal;
+    }
+    document_ids_ = std::move(document_ids);
+    ratings_ = std::move(ratings);
+    statuses_ = std::move(statuses);
+    document_lengths_ = std::move(document_lengths);
+    ordinal_to_term_counts_ = std::move(ordinal_to_term_counts);
+
+    for(TermId term_id = 0; term_id < term_to_postings_.size(); ++term_id) {
+        RebuildPostings(term_id, &old_to_new);
+    }
+}
+
+void SearchServer::RebuildPostings(TermId term_id, const std::vector<DocumentOrdinal>* old_to_new) {
+    std::vector<std::pair<DocumentOrdinal, uint32_t>> postings;
+    for(PostingCursor cursor(term_to_postings_[term_id]); !cursor.IsEnd(); cursor.Next()) {
+        if(old_to_new != nullptr) {
+            if((*old_to_new)[cursor.GetOrdinal()] != NO_ORDINAL) {
+                postings.emplace_back((*old_to_new)[cursor.GetOrdinal()], cursor.GetCount());
             }
+        } else if(document_ids_[cursor.GetOrdinal()] != REMOVED_DOCUMENT_ID) {
+            postings.emplace_back(cursor.GetOrdinal(), cursor.GetCount());
         }
+    }
+    if(old_to_new != nullptr) {
+        std::sort(postings.begin(), postings.end());
+    }
+
+    PostingList rebuilt;
+    for(const auto& [ordinal, count] : postings) {
+        rebuilt.Append(ordinal, count, GetTf(ordinal, count));
+    }
+    rebuilt.ShrinkToFit();
+    term_to_postings_[term_id] = std::move(rebuilt);
+    term_to_removed_posting_count_[term_id] = 0;
+}
+
+double SearchServer::GetTf(DocumentOrdinal ordinal, uint32_t count) const {
+    return static_cast<double>(count) / document_lengths_[ordinal];
+}
 
-        id_to_document_.erase(document_id);
-        --document_count_;
+SearchServer::IndexStatistics SearchServer::GetIndexStatistics() const {
+    IndexStatistics statistics;
+    for(const PostingList& postings : term_to_postings_) {
+        statistics.posting_count_ += postings.size();
+        statistics.posting_bytes_ += postings.GetMemoryUsage();
     }
+    return statistics;
 }
 
 SearchServer::iterator SearchServer::begin() noexcept {
-    return id_to_document_.begin();
+    return {id_to_ordinal_.cbegin(), this};
 }
 
 SearchServer::iterator SearchServer::end() noexcept {
-    return id_to_document_.end();
+    return {id_to_ordinal_.cend(), this};
 }
 SearchServer::const_iterator SearchServer::begin() const noexcept {
-    return id_to_document_.begin();
+    return {id_to_ordinal_.cbegin(), this};
 }
 SearchServer::const_iterator SearchServer::end() const noexcept {
-    return id_to_document_.end();
+    return {id_to_ordinal_.cend(), this};
 }
 SearchServer::const_iterator SearchServer::cbegin() noexcept {
-    return id_to_document_.cbegin();
+    return {id_to_ordinal_.cbegin(), this};
 }
 SearchServer::const_iterator SearchServer::cend() noexcept {
-    return id_to_document_.cend();
+    return {id_to_ordinal_.cend(), this};
 }
 
-std::vector<std::string> SearchServer::SplitIntoWords(const std::string& text) const {
-    std::vector<std::string> words;
-    std::string word;
-    for (const char c : text) {
-        if (c == ' ' && !word.empty()) {
+std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
+    std::vector<std::string_view> words;
+    ForEachWord(text, [this, &words](std::string_view word) {
+        if (!stop_words_.contains(word)) {
             words.push_back(word);
-            word = "";
-        } else if(c != ' '){
-            word += c;
         }
+    });
+    return words;
+}
+
+namespace {
+    // Scratch state of the calling thread, kept between its queries so long
+    // lived workers don't allocate per query. A query a predicate starts
+    // inside another one on the same thread gets a fresh one instead.
+    template <typename Scratch>
+    class ThreadScratch {
+    public:
+        ThreadScratch() {
+            Slot& slot = GetSlot();
+            if(slot.is_in_use_) {
+                owned_ = std::make_unique<Scratch>();
+                scratch_ = owned_.get();
+            } else {
+                slot.is_in_use_ = true;
+                scratch_ = &slot.scratch_;
+            }
+        }
+
+        ThreadScratch(const ThreadScratch&) = delete;
+        ThreadScratch& operator=(const ThreadScratch&) = delete;
+
+        ~ThreadScratch() {
+            if(!owned_) {
+                GetSlot().is_in_use_ = false;
+            }
+        }
+
+        Scratch& operator*() const noexcept {
+            return *scratch_;
+        }
+
+        Scratch* operator->() const noexcept {
+            return scratch_;
+        }
+
+    private:
+        struct Slot {
+            Scratch scratch_;
+            bool is_in_use_ = false;
+        };
+
+        std::unique_ptr<Scratch> owned_;
+        Scratch* scratch_;
+
+        static Slot& GetSlot() {
+            thread_local Slot slot;
+            return slot;
+        }
+    };
+
+    // Dense accumulator indexed by ordinal. Only the range of ordinals a
+    // query touched is cleared after it.
+    struct ScoreAccumulator {
+        static constexpr uint32_t SELECT_CHUNK_SIZE = 4096;
+
+        std::vector<double> scores_;
+        std::vector<uint8_t> matched_;
+        std::vector<uint32_t> selected_ = std::vector<uint32_t>(SELECT_CHUNK_SIZE);
+
+        void Reserve(size_t document_count) {
+            if(scores_.size() < document_count) {
+                scores_.resize(document_count, 0.0);
+                matched_.resize(document_count, 0);
+            }
+        }
+
+        void Reset(uint32_t begin, uint32_t end) {
+            std::fill(scores_.begin() + begin, scores_.begin() + end, 0.0);
+            std::fill(matched_.begin() + begin, matched_.begin() + end, 0);
+        }
+    };
+
+    struct TermCursor {
+        PostingCursor postings_;
+        double idf_;
+        double upper_bound_;
+        size_t query_index_;
+
+        bool IsAt(uint32_t ordinal) const {
+            return !postings_.IsEnd() && postings_.GetOrdinal() == ordinal;
+        }
+    };
+
+    struct MaxScoreScratch {
+        std::vector<TermCursor> cursors_;
+        std::vector<double> prefix_upper_bounds_;
+        std::vector<double> contributions_;
+    };
+}
+
+SearchServer::Document SearchServer::GetDocument(DocumentOrdinal ordinal) const {
+    return {document_ids_[ordinal], ratings_[ordinal], statuses_[ordinal]};
+}
+
+double SearchServer::ComputeTermIdf(TermId term_id, const CorpusStatistics* corpus_statistics) const {
+    if(corpus_statistics == nullptr) {
+        return log_document_count_ - term_to_log_document_freq_[term_id];
     }
+    return ComputeIdf(corpus_statistics->document_count_, 
+                      corpus_statistics->document_frequency_(terms_.GetTerm(term_id)));
+}
 
-    if (!word.empty()) {
-        words.push_back(word);
+bool SearchServer::IsAllowed(DocumentOrdinal ordinal, const DocumentFilter* filter) const {
+    return filter == nullptr 
+        || (status_to_documents_[static_cast<size_t>(filter->status_)].Contains(ordinal) 
+            && ratings_[ordinal] >= filter->min_rating_ && ratings_[ordinal] <= filter->max_rating_);
+}
+
+bool SearchServer::IsScorable(DocumentOrdinal ordinal, const DocumentFilter* filter) const {
+    return document_ids_[ordinal] != REMOVED_DOCUMENT_ID && IsAllowed(ordinal, filter);
+}
+
+bool SearchServer::IsCandidate(TopDocumentsSearch& search, DocumentOrdinal ordinal) const {
+    if(!IsScorable(ordinal, search.filter_)) {
+        return false;
     }
+    // block headers skip the minus word postings far behind the candidate
+    for(PostingCursor& minus_cursor : search.minus_cursors_) {
+        minus_cursor.SeekTo(ordinal);
+        if(!minus_cursor.IsEnd() && minus_cursor.GetOrdinal() == ordinal) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    return words;
+void SearchServer::OfferDocument(TopDocumentsSearch& search, DocumentOrdinal ordinal, double relevance) const {
+    Document document = GetDocument(ordinal);
+    document.relevance_ = relevance;
+    if(search.after_ != nullptr) {
+        Document last_seen(search.after_->id_, search.after_->rating_, DocumentStatus::ACTUAL);
+        last_seen.relevance_ = search.after_->relevance_;
+        if(!IsBeforeInPages(last_seen, document)) {
+            return;
+        }
+    }
+    if(search.document_predicate_ == nullptr 
+            || (*search.document_predicate_)(document_ids_[ordinal], statuses_[ordinal], ratings_[ordinal])) {
+        PushTopDocument(search, document, relevance);
+    }
 }
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string& text) const {
-    std::vector<std::string> words;
-    for (const std::string& word : SplitIntoWords(text)) {
-        if (stop_words_.count(word) == 0) {
-            words.push_back(word);
+double SearchServer::GetMinCompetitiveRelevance(const TopDocumentsSearch& search) {
+    if(search.top_documents_.size() < search.limit_) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    const double weakest = search.top_documents_.front().relevance_;
+    if(search.is_more_relevant_ != IsMoreRelevant) {
+        return weakest;
+    }
+    // r loses to the weakest top document w when w - r > EPSILON * max(|w|, |r|)
+    return weakest >= 0.0 ? weakest * (1.0 - EPSILON) : weakest / (1.0 - EPSILON);
+}
+
+std::vector<SearchServer::Document> SearchServer::SearchTopDocuments(std::string_view raw_query, 
+        const CorpusStatistics* corpus_statistics, TopDocumentsSearch search) const {
+    const Query query_terms = ParseQuery(raw_query);
+    for(TermId plus_term : query_terms.plus_terms_) {
+        const PostingList& postings = term_to_postings_[plus_term];
+        if(CountLiveDocuments(plus_term) > 0) {
+            const double idf = ComputeTermIdf(plus_term, corpus_statistics);
+            search.terms_.push_back({&postings, idf, idf * postings.GetMaxTf()});
         }
     }
-    return words;
+    return RunTopDocumentsSearch(query_terms, search);
+}
+
+std::vector<SearchServer::Document> SearchServer::RunTopDocumentsSearch(const Query& query_terms, 
+        TopDocumentsSearch& search) const {
+    if(search.terms_.empty()) {
+        return {};
+    }
+    search.top_documents_.reserve(search.limit_ + 1);
+    for(TermId minus_term : query_terms.minus_terms_) {
+        if(CountLiveDocuments(minus_term) > 0) {
+            search.minus_cursors_.emplace_back(term_to_postings_[minus_term]);
+        }
+    }
+
+    if(IsTermAtATimeFaster(search.terms_)) {
+        ScoreTermAtATime(search);
+    } else {
+        ScoreWithMaxScore(search);
+    }
+
+    std::sort_heap(search.top_documents_.begin(), search.top_documents_.end(), search.is_more_relevant_);
+    return std::move(search.top_documents_);
 }
 
-int SearchServer::GetRating(int document_id) const {
-    return id_to_document_.at(document_id).rating_;
+bool SearchServer::IsTermAtATimeFaster(const std::vector<ScoredTerm>& terms) {
+    bool has_negative_idf = false;
+    size_t posting_count = 0;
+    DocumentOrdinal first_ordinal = std::numeric_limits<DocumentOrdinal>::max();
+    DocumentOrdinal last_ordinal = 0;
+    for(const ScoredTerm& term : terms) {
+        has_negative_idf = has_negative_idf || term.idf_ < 0.0;
+        posting_count += term.postings_->size();
+        first_ordinal = std::min(first_ordinal, term.postings_->GetFirstOrdinal());
+        last_ordinal = std::max(last_ordinal, term.postings_->GetLastOrdinal());
+    }
+    const bool is_dense = posting_count * 16 >= static_cast<size_t>(last_ordinal - first_ordinal) + 1;
+    return has_negative_idf || (terms.size() <= 2 && is_dense);
 }
 
-std::vector<SearchServer::Document> SearchServer::FindAllDocuments(const std::string& raw_query) const {
-    const SearchServer::Query query_words = ParseQuery(raw_query);
-    std::unordered_map<int, double> document_to_relevance;
+std::vector<std::vector<SearchServer::Document>> SearchServer::FindTopDocumentsBatch(
+        std::span<const std::string> raw_queries) const {
+    return RunTopDocumentsBatch(raw_queries, [](size_t count, const std::function<void(size_t)>& task) {
+        std::vector<size_t> indexes(count);
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(std::execution::par, indexes.begin(), indexes.end(), task);
+    });
+}
 
-    for(const auto& [document_id, document] : id_to_document_) {
-        for (const std::string& plus_word : query_words.plus_words_) {
-            if(!document.word_to_freqs_.contains(plus_word)) {
-                continue;
+std::vector<std::vector<SearchServer::Document>> SearchServer::FindTopDocumentsBatch(QueryExecutor& executor, 
+        std::span<const std::string> raw_queries) const {
+    return RunTopDocumentsBatch(raw_queries, [&executor](size_t count, const std::function<void(size_t)>& task) {
+        executor.ParallelFor(count, task);
+    });
+}
+
+std::vector<std::vector<SearchServer::Document>> SearchServer::RunTopDocumentsBatch(std::span<const std::string> raw_queries, 
+        const std::function<void(size_t, const std::function<void(size_t)>&)>& parallel_for) const {
+    // identical queries share one search
+    std::map<Query, size_t> query_to_index;
+    std::vector<const Query*> distinct_queries;
+    std::vector<size_t> query_indexes;
+    query_indexes.reserve(raw_queries.size());
+    for(const std::string& raw_query : raw_queries) {
+        auto [it, is_new] = query_to_index.emplace(ParseQuery(raw_query), distinct_queries.size());
+        if(is_new) {
+            distinct_queries.push_back(&it->first);
+        }
+        query_indexes.push_back(it->second);
+    }
+
+    // every distinct plus word with postings, with its idf
+    std::vector<TermId> term_ids;
+    for(const Query* query : distinct_queries) {
+        for(TermId plus_term : query->plus_terms_) {
+            if(CountLiveDocuments(plus_term) > 0) {
+                term_ids.push_back(plus_term);
             }
-            int word_meet_count = static_cast<int>(word_to_count_.at(plus_word));
-            double tf = document.word_to_freqs_.at(plus_word);
-            double idf = std::log(static_cast<double>(document_count_) / word_meet_count);
-            document_to_relevance[document_id] += tf * idf;
         }
     }
+    std::sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+    std::vector<ScoredTerm> terms;
+    terms.reserve(term_ids.size());
+    for(TermId term_id : term_ids) {
+        const PostingList& postings = term_to_postings_[term_id];
+        const double idf = ComputeTermIdf(term_id, nullptr);
+        terms.push_back({&postings, idf, idf * postings.GetMaxTf()});
+    }
+
+    // plus words of each query as indexes into terms, in query order
+    std::vector<std::vector<size_t>> query_term_indexes(distinct_queries.size());
+    std::vector<uint32_t> term_at_a_time_use_counts(terms.size(), 0);
+    std::vector<ScoredTerm> query_terms;
+    for(size_t i = 0; i < distinct_queries.size(); ++i) {
+        query_terms.clear();
+        for(TermId plus_term : distinct_queries[i]->plus_terms_) {
+            if(CountLiveDocuments(plus_term) > 0) {
+                const size_t term_index = std::lower_bound(term_ids.begin(), term_ids.end(), plus_term) - term_ids.begin();
+                query_term_indexes[i].push_back(term_index);
+                query_terms.push_back(terms[term_index]);
+            }
+        }
+        if(!query_terms.empty() && IsTermAtATimeFaster(query_terms)) {
+            for(size_t term_index : query_term_indexes[i]) {
+                ++term_at_a_time_use_counts[term_index];
+            }
+        }
+    }
+
+    // The postings several queries add up with the kernels are decoded once.
+    // Every query of a batch uses the default filter, so the documents it
+    // rejects are dropped while decoding.
+    const DocumentFilter batch_filter;
+    std::vector<DecodedPostings> decoded_postings(terms.size());
+    std::vector<size_t> shared_term_indexes;
+    for(size_t term_index = 0; term_index < terms.size(); ++term_index) {
+        if(term_at_a_time_use_counts[term_index] > 1) {
+            shared_term_indexes.push_back(term_index);
+            terms[term_index].decoded_ = &decoded_postings[term_index];
+        }
+    }
+    parallel_for(shared_term_indexes.size(), 
+        [this, &terms, &decoded_postings, &batch_filter, &shared_term_indexes](size_t i) {
+            const size_t term_index = shared_term_indexes[i];
+            DecodedPostings& decoded = decoded_postings[term_index];
+            decoded.ordinals_.reserve(terms[term_index].postings_->size());
+            decoded.tfs_.reserve(terms[term_index].postings_->size());
+            for(PostingCursor cursor(*terms[term_index].postings_); !cursor.IsEnd(); cursor.Next()) {
+                if(!IsScorable(cursor.GetOrdinal(), &batch_filter)) {
+                    continue;
+                }
+                decoded.ordinals_.push_back(cursor.GetOrdinal());
+                decoded.tfs_.push_back(GetTf(cursor.GetOrdinal(), cursor.GetCount()));
+            }
+        });
+
+    std::vector<std::vector<Document>> distinct_results(distinct_queries.size());
+    parallel_for(distinct_queries.size(), 
+        [this, &distinct_queries, &query_term_indexes, &terms, &distinct_results, &batch_filter](size_t i) {
+            TopDocumentsSearch search;
+            search.filter_ = &batch_filter;
+            for(size_t term_index : query_term_indexes[i]) {
+                search.terms_.push_back(terms[term_index]);
+            }
+            distinct_results[i] = RunTopDocumentsSearch(*distinct_queries[i], search);
+        });
 
+    std::vector<std::vector<Document>> results;
+    results.reserve(raw_queries.size());
+    for(size_t query_index : query_indexes) {
+        results.push_back(distinct_results[query_index]);
+    }
+    return results;
+}
+
+void SearchServer::ScoreTermAtATime(TopDocumentsSearch& search) const {
+    const ThreadScratch<ScoreAccumulator> scratch;
+    ScoreAccumulator& accumulator = *scratch;
+    accumulator.Reserve(document_ids_.size());
+
+    DocumentOrdinal begin = std::numeric_limits<DocumentOrdinal>::max();
+    DocumentOrdinal end = 0;
+    std::array<uint32_t, PostingList::BLOCK_SIZE> ordinals;
+    std::array<uint32_t, PostingList::BLOCK_SIZE> counts;
+    std::array<double, PostingList::BLOCK_SIZE> tfs;
+    for(const ScoredTerm& term : search.terms_) {
+        const PostingList& postings = *term.postings_;
+        if(term.decoded_ != nullptr) {
+            AccumulateScores(term.decoded_->ordinals_.data(), term.decoded_->tfs_.data(), term.decoded_->ordinals_.size(), 
+                             term.idf_, accumulator.scores_.data(), accumulator.matched_.data());
+        } else {
+            // documents the search can't return are dropped before scoring,
+            // the kernel then runs on what is left of the block
+            for(size_t block_index = 0; block_index < postings.GetBlockCount(); ++block_index) {
+                const size_t block_size = postings.DecodeBlock(block_index, ordinals.data(), counts.data());
+                size_t scored_count = 0;
+                for(size_t i = 0; i < block_size; ++i) {
+                    if(IsScorable(ordinals[i], search.filter_)) {
+                        ordinals[scored_count] = ordinals[i];
+                        tfs[scored_count] = GetTf(ordinals[i], counts[i]);
+                        ++scored_count;
+                    }
+                }
+                AccumulateScores(ordinals.data(), tfs.data(), scored_count, term.idf_, 
+                                 accumulator.scores_.data(), accumulator.matched_.data());
+            }
+        }
+        begin = std::min(begin, postings.GetFirstOrdinal());
+        end = std::max(end, postings.GetLastOrdinal() + 1);
+    }
+
+    // the kernel drops every document below the current top in bulk, the
+    // few that remain are checked against the minus words and the predicate
+    try {
+        for(DocumentOrdinal chunk_begin = begin; chunk_begin < end; chunk_begin += ScoreAccumulator::SELECT_CHUNK_SIZE) {
+            const DocumentOrdinal chunk_end = std::min(end, chunk_begin + ScoreAccumulator::SELECT_CHUNK_SIZE);
+            const size_t selected_count = SelectCandidates(accumulator.scores_.data(), accumulator.matched_.data(), 
+                chunk_begin, chunk_end, GetMinCompetitiveRelevance(search), accumulator.selected_.data());
+            for(size_t i = 0; i < selected_count; ++i) {
+                const DocumentOrdinal ordinal = accumulator.selected_[i];
+                const double relevance = accumulator.scores_[ordinal];
+                if(relevance >= GetMinCompetitiveRelevance(search) && IsCandidate(search, ordinal)) {
+                    OfferDocument(search, ordinal, relevance);
+                }
+            }
+        }
+    } catch(...) {
+        accumulator.Reset(begin, end);
+        throw;
+    }
+    accumulator.Reset(begin, end);
+}
+
+void SearchServer::ScoreWithMaxScore(TopDocumentsSearch& search) const {
+    // Cursors are ordered by upper bound, and the shortest prefix whose bounds
+    // add up to less than the current threshold is non-essential. A document
+    // matching only non-essential terms can't enter the top, so candidates
+    // come from the essential cursors and the rest is only probed.
+    const ThreadScratch<MaxScoreScratch> scratch;
+    std::vector<TermCursor>& cursors = scratch->cursors_;
+    cursors.clear();
+    for(size_t i = 0; i < search.terms_.size(); ++i) {
+        const ScoredTerm& term = search.terms_[i];
+        cursors.push_back({PostingCursor(*term.postings_), term.idf_, term.upper_bound_, i});
+    }
+    std::sort(cursors.begin(), cursors.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.upper_bound_ < rhs.upper_bound_;
+    });
+    std::vector<double>& prefix_upper_bounds = scratch->prefix_upper_bounds_;
+    prefix_upper_bounds.resize(cursors.size());
+    double upper_bound_sum = 0.0;
+    for(size_t i = 0; i < cursors.size(); ++i) {
+        upper_bound_sum += cursors[i].upper_bound_;
+        // slack for rounding, so a bound never ends up below the exact sum
+        prefix_upper_bounds[i] = upper_bound_sum * (1.0 + 1e-12);
+    }
 
-    for(const auto& [document_id, document] : id_to_document_) {
-        for (const std::string& minus_word : query_words.minus_words_) {
-            if(!document.word_to_freqs_.contains(minus_word)) {
+    std::vector<double>& contributions = scratch->contributions_;
+    contributions.assign(search.terms_.size(), 0.0);
+    size_t first_essential = 0;
+
+    while(first_essential < cursors.size()) {
+        DocumentOrdinal candidate = std::numeric_limits<DocumentOrdinal>::max();
+        for(size_t i = first_essential; i < cursors.size(); ++i) {
+            if(!cursors[i].postings_.IsEnd()) {
+                candidate = std::min(candidate, cursors[i].postings_.GetOrdinal());
+            }
+        }
+        if(candidate == std::numeric_limits<DocumentOrdinal>::max()) {
+            break;
+        }
+
+        const bool is_candidate = IsCandidate(search, candidate);
+        double score_bound = 0.0;
+        for(size_t i = first_essential; i < cursors.size(); ++i) {
+            auto& cursor = cursors[i];
+            if(cursor.IsAt(candidate)) {
+                if(is_candidate) {
+                    contributions[cursor.query_index_] = GetTf(candidate, cursor.postings_.GetCount()) * cursor.idf_;
+                    score_bound += contributions[cursor.query_index_];
+                }
+                cursor.postings_.Next();
+            }
+        }
+        if(!is_candidate) {
+            continue;
+        }
+
+        const double min_relevance = GetMinCompetitiveRelevance(search);
+        bool is_pruned = false;
+        for(size_t i = first_essential; i-- > 0;) {
+            if(score_bound * (1.0 + 1e-12) + prefix_upper_bounds[i] < min_relevance) {
+                is_pruned = true;
+                break;
+            }
+            // the block that may hold the candidate gives a tighter bound
+            // than the whole list, and checking it decodes nothing
+            auto& cursor = cursors[i];
+            cursor.postings_.ShallowSeekTo(candidate);
+            if(cursor.postings_.IsEnd()) {
                 continue;
-            } else {
-                document_to_relevance.erase(document_id);
+            }
+            const double other_upper_bounds = i > 0 ? prefix_upper_bounds[i - 1] : 0.0;
+            if((score_bound + cursor.postings_.GetBlockMaxTf() * cursor.idf_) * (1.0 + 1e-12) 
+                    + other_upper_bounds < min_relevance) {
+                is_pruned = true;
+                break;
+            }
+            cursor.postings_.SeekTo(candidate);
+            if(cursor.IsAt(candidate)) {
+                contributions[cursor.query_index_] = GetTf(candidate, cursor.postings_.GetCount()) * cursor.idf_;
+                score_bound += contributions[cursor.query_index_];
             }
         }
+
+        if(!is_pruned && score_bound * (1.0 + 1e-12) >= min_relevance) {
+            // summed in query order, exactly like the term-at-a-time accumulator
+            double relevance = 0.0;
+            for(double contribution : contributions) {
+                relevance += contribution;
+            }
+            OfferDocument(search, candidate, relevance);
+
+            const double threshold = GetMinCompetitiveRelevance(search);
+            while(first_essential < cursors.size() && prefix_upper_bounds[first_essential] < threshold) {
+                ++first_essential;
+            }
+        }
+        std::fill(contributions.begin(), contributions.end(), 0.0);
+    }
+}
+
+double SearchServer::ComputeIdf(int document_count, int document_frequency) {
+    if(document_frequency <= 0) {
+        return 0.0;
+    }
+    return std::log(document_count) - std::log(document_frequency);
+}
+
+void SearchServer::UpdateLogDocumentFreq(TermId term_id) {
+    const int document_freq = CountLiveDocuments(term_id);
+    term_to_log_document_freq_[term_id] = document_freq > 0 ? std::log(document_freq) : 0.0;
+}
+
+int SearchServer::CountLiveDocuments(TermId term_id) const {
+    return static_cast<int>(term_to_postings_[term_id].size() - term_to_removed_posting_count_[term_id]);
+}
+
+bool SearchServer::IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if(std::abs(lhs.relevance_ - rhs.relevance_) <= 
+            EPSILON * std::max(std::abs(lhs.relevance_), std::abs(rhs.relevance_))) {
+        return lhs.rating_ > rhs.rating_; 
+    }
+    return lhs.relevance_ > rhs.relevance_;
+}
+
+bool SearchServer::IsBeforeInPages(const Document& lhs, const Document& rhs) {
+    if(lhs.relevance_ != rhs.relevance_) {
+        return lhs.relevance_ > rhs.relevance_;
     }
- 
-    std::vector<Document> found_documents;
-    for (auto [document_id, relevance] : document_to_relevance) {
-        found_documents.push_back(id_to_document_.at(document_id));
-        found_documents.back().relevance_ = relevance;
+    if(lhs.rating_ != rhs.rating_) {
+        return lhs.rating_ > rhs.rating_;
+    }
+    return lhs.id_ < rhs.id_;
+}
+
+void SearchServer::PushTopDocument(TopDocumentsSearch& search, const Document& document, double relevance) {
+    std::vector<Document>& top_documents = search.top_documents_;
+    top_documents.push_back(document);
+    top_documents.back().relevance_ = relevance;
+    std::push_heap(top_documents.begin(), top_documents.end(), search.is_more_relevant_);
+    if(top_documents.size() > search.limit_) {
+        std::pop_heap(top_documents.begin(), top_documents.end(), search.is_more_relevant_);
+        top_documents.pop_back();
+    }
+}
+
+void SearchServer::PushTopDocument(std::vector<Document>& top_documents, const Document& document, double relevance) {
+    // top_documents is a heap with the least relevant document on top,
+    // so it never grows beyond MAX_RESULT_DOCUMENT_COUNT + 1
+    top_documents.push_back(document);
+    top_documents.back().relevance_ = relevance;
+    std::push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+    if(top_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        std::pop_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+        top_documents.pop_back();
     }
-    return found_documents;
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& rates) {
@@ -199,7 +996,7 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& rates) {
     return avg_rating;
 }
 
-void SearchServer::CheckUnacceptableSymbols(const std::string& word) const {
+void SearchServer::CheckUnacceptableSymbols(std::string_view word) const {
     if(word.empty()) {
         throw std::invalid_argument("Stop words can't be empty!");
     }
@@ -211,41 +1008,119 @@ void SearchServer::CheckUnacceptableSymbols(const std::string& word) const {
     }
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string& raw_query) const {
-    SearchServer::Query query_words;
-    for (const std::string& word : SplitIntoWordsNoStop(raw_query)) {
-        CheckUnacceptableSymbols(word);
-        if(word[0] == '-') {
-            if(word.size() == 1 || word[1] == '-') {
-                throw std::invalid_argument("Word can't be '-' or '--...'!");
-            }
-            query_words.minus_words_.insert(word.substr(1));
-        } else {
-            query_words.plus_words_.insert(word);
+SearchServer::Query SearchServer::ParseQuery(std::string_view raw_query) const {
+    SearchServer::Query query_terms;
+    auto is_stop_word = [this](std::string_view word) {
+        return stop_words_.contains(word);
+    };
+    ForEachQueryWord(raw_query, is_stop_word, [this, &query_terms](std::string_view word, bool is_minus) {
+        if(TermId term_id = terms_.Find(word); term_id != NO_TERM) {
+            (is_minus ? query_terms.minus_terms_ : query_terms.plus_terms_).push_back(term_id);
         }
+    });
+    NormalizeQuery(query_terms);
+    return query_terms;
+}
+
+void SearchServer::NormalizeQuery(Query& query) {
+    for(auto* terms : {&query.plus_terms_, &query.minus_terms_}) {
+        std::sort(terms->begin(), terms->end());
+        terms->erase(std::unique(terms->begin(), terms->end()), terms->end());
     }
-    return query_words;
 }
 
-void RemoveDuplicates(SearchServer& search_server) {
-    std::set<std::set<std::string>> sets;
-    std::vector<int> duplicates_ids;
+bool SearchServer::ContainsTerm(const TermCounts& term_counts, TermId term_id) {
+    auto it = std::lower_bound(term_counts.begin(), term_counts.end(), term_id, 
+        [](const std::pair<TermId, uint32_t>& term_count, TermId id) {
+            return term_count.first < id;
+        });
+    return it != term_counts.end() && it->first == term_id;
+}
 
-    for (const auto& [document_id, document] : search_server) {
-        std::set<std::string> current_set;
-        for(const auto& [word, _] : document.word_to_freqs_) {
-            current_set.insert(word);
-        }
+namespace {
+    struct WordSetHash {
+        uint64_t low_ = 0;
+        uint64_t high_ = 0;
+
+        auto operator<=>(const WordSetHash&) const = default;
+    };
+
+    // the MurmurHash3 64-bit finalizer
+    uint64_t MixBits(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ULL;
+        value ^= value >> 33;
+        return value;
+    }
 
-        if(sets.contains(current_set)) {
-            duplicates_ids.push_back(document_id);
+    // A cheap hash of the sorted term ids, only used to group candidates:
+    // equal word sets always land in one group, and HaveSameTerms compares
+    // the documents of a group exactly, so colliding sets are never merged.
+    WordSetHash ComputeWordSetHash(const std::vector<std::pair<TermId, uint32_t>>& term_counts) {
+        uint64_t low = 0x9e3779b97f4a7c15ULL;
+        uint64_t high = 0x6a09e667f3bcc909ULL;
+        for(const auto& [term_id, _] : term_counts) {
+            low = MixBits(low ^ (term_id + 0x94d049bb133111ebULL));
+            high = MixBits((high + term_id) * 0xbf58476d1ce4e5b9ULL);
         }
-        sets.insert(current_set);
+        return {MixBits(low ^ term_counts.size()), MixBits(high + term_counts.size())};
+    }
+
+    bool HaveSameTerms(const std::vector<std::pair<TermId, uint32_t>>& lhs, 
+            const std::vector<std::pair<TermId, uint32_t>>& rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+            [](const auto& lhs_entry, const auto& rhs_entry) {
+                return lhs_entry.first == rhs_entry.first;
+            });
+    }
+}
+
+void RemoveDuplicates(SearchServer& search_server) {
+    struct Candidate {
+        WordSetHash hash_;
+        int document_id_;
+        const SearchServer::TermCounts* term_counts_;
+    };
+
+    std::vector<Candidate> candidates;
+    candidates.reserve(search_server.id_to_ordinal_.size());
+    for(const auto& [document_id, ordinal] : search_server.id_to_ordinal_) {
+        candidates.push_back({{}, document_id, &search_server.ordinal_to_term_counts_[ordinal]});
     }
 
-    for(auto id : duplicates_ids) {
-        search_server.RemoveDocument(id);
+    std::for_each(std::execution::par, candidates.begin(), candidates.end(), [](Candidate& candidate) {
+        candidate.hash_ = ComputeWordSetHash(*candidate.term_counts_);
+    });
+    std::sort(std::execution::par, candidates.begin(), candidates.end(), 
+        [](const Candidate& lhs, const Candidate& rhs) {
+            return std::tie(lhs.hash_, lhs.document_id_) < std::tie(rhs.hash_, rhs.document_id_);
+        });
+
+    std::vector<int> duplicates_ids;
+    std::vector<const Candidate*> originals;
+    for(auto group_begin = candidates.begin(); group_begin != candidates.end();) {
+        auto group_end = std::find_if(group_begin, candidates.end(), [group_begin](const Candidate& candidate) {
+            return candidate.hash_ != group_begin->hash_;
+        });
+
+        // ids ascend inside a group, so the first document of every distinct word set is kept
+        originals.clear();
+        for(auto it = group_begin; it != group_end; ++it) {
+            bool is_duplicate = std::any_of(originals.begin(), originals.end(), [it](const Candidate* original) {
+                return HaveSameTerms(*original->term_counts_, *it->term_counts_);
+            });
+            if(is_duplicate) {
+                duplicates_ids.push_back(it->document_id_);
+            } else {
+                originals.push_back(&*it);
+            }
+        }
+        group_begin = group_end;
     }
+
+    search_server.RemoveDocuments(duplicates_ids);
 }
 
 std::ostream& operator<<(std::ostream& out, const SearchServer::Document& document) {
@@ -1,12 +1,25 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <set>
+#include <span>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <iostream>
 #include <execution>
+#include <functional>
 #include <algorithm>
+#include <iterator>
+#include <cstdint>
+#include <array>
+#include <limits>
+#include "document_bitmap.h"
 #include "paginator.h"
+#include "posting_list.h"
+#include "query_executor.h"
+#include "term_dictionary.h"
+#include "tokenizer.h"
 
 using namespace std::string_literals;
 
@@ -14,6 +27,9 @@ static constexpr size_t MAX_RESULT_DOCUMENT_COUNT = 5;
 static constexpr double EPSILON = 1e-6;
 
 class SearchServer {
+    friend class IndexSnapshot;
+    friend void RemoveDuplicates(SearchServer& search_server);
+
 public:
     enum class DocumentStatus {
         ACTUAL,
@@ -26,24 +42,140 @@ public:
         int id_;
         int rating_;
         double relevance_;
-        std::map<std::string, double> word_to_freqs_;
         DocumentStatus status_;
 
         Document();
         Document(int id, int rating, DocumentStatus status);
     };
 
+    // Size of a corpus split between several servers and the number of its
+    // documents containing a word. Scoring a part of the corpus with these
+    // gives the same relevance as a single server holding all of it.
+    struct CorpusStatistics {
+        int document_count_;
+        std::function<int(std::string_view)> document_frequency_;
+    };
+
+    // Restricts a search before scoring: only documents with status_ and a
+    // rating in [min_rating_, max_rating_] have their relevance computed.
+    struct DocumentFilter {
+        DocumentStatus status_ = DocumentStatus::ACTUAL;
+        int min_rating_ = std::numeric_limits<int>::min();
+        int max_rating_ = std::numeric_limits<int>::max();
+    };
+
+    // Position right after a document in the order of paged searches. The
+    // string form is opaque to clients and round-trips the position exactly.
+    struct SearchCursor {
+        double relevance_ = 0.0;
+        int rating_ = 0;
+        int id_ = 0;
+
+        static SearchCursor After(const Document& document);
+
+        std::string ToString() const;
+
+        // Throws std::invalid_argument if text wasn't made by ToString.
+        static SearchCursor FromString(std::string_view text);
+    };
+
+    // memory taken by the inverted index
+    struct IndexStatistics {
+        size_t posting_count_ = 0;
+        size_t posting_bytes_ = 0;
+    };
+
+    // one entry of an AddDocuments batch, text_ must outlive the call
+    struct DocumentInput {
+        int id_;
+        std::string_view text_;
+        DocumentStatus status_;
+        std::vector<int> ratings_;
+    };
+
 private:
+    // both vectors are sorted and hold only words known to the dictionary
     struct Query {
-        std::set<std::string> plus_words_;
-        std::set<std::string> minus_words_;
+        std::vector<TermId> plus_terms_;
+        std::vector<TermId> minus_terms_;
+
+        auto operator<=>(const Query&) const = default;
+    };
+
+    // (term, count) pairs of a document sorted by term id, the tf of a term
+    // is its count divided by the document's length
+    using TermCounts = std::vector<std::pair<TermId, uint32_t>>;
+
+    // Dense position of a document in the per-document arrays. New documents
+    // get the next ordinal, slots of removed ones are reclaimed by CompactOrdinals.
+    using DocumentOrdinal = uint32_t;
+
+    // postings of a word decoded once for several queries of a batch
+    struct DecodedPostings {
+        std::vector<uint32_t> ordinals_;
+        std::vector<double> tfs_;
+    };
+
+    // a plus word of a query that has postings
+    struct ScoredTerm {
+        const PostingList* postings_;
+        double idf_;
+        double upper_bound_;
+        const DecodedPostings* decoded_ = nullptr;
+    };
+
+    // state shared by both ways of collecting the top documents of a query
+    struct TopDocumentsSearch {
+        std::vector<ScoredTerm> terms_;  // in query order
+        std::vector<PostingCursor> minus_cursors_;
+        const DocumentFilter* filter_ = nullptr;
+        const std::function<bool(int, DocumentStatus, int)>* document_predicate_ = nullptr;
+        // the first limit_ documents by is_more_relevant_, following after_ if it is set
+        size_t limit_ = MAX_RESULT_DOCUMENT_COUNT;
+        bool (*is_more_relevant_)(const Document&, const Document&) = IsMoreRelevant;
+        const SearchCursor* after_ = nullptr;
+        std::vector<Document> top_documents_;
+    };
+
+    // id of a document slot that was removed and not yet compacted
+    static constexpr int REMOVED_DOCUMENT_ID = -1;
+
+    static constexpr DocumentOrdinal NO_ORDINAL = std::numeric_limits<DocumentOrdinal>::max();
+
+    static constexpr size_t STATUS_COUNT = 4;
+
+    // a tokenized document that is not yet part of the index, the views
+    // point into the source text
+    struct ParsedDocument {
+        std::vector<std::pair<std::string_view, uint32_t>> word_counts_;
+        uint32_t length_ = 0;
+        int rating_ = 0;
     };
 
 private:
-    std::set<std::string> stop_words_;
-    std::map<int, Document> id_to_document_;
-    std::map<std::string, int> word_to_count_;
+    std::set<std::string, std::less<>> stop_words_;
+    TermDictionary terms_;
+    std::map<int, DocumentOrdinal> id_to_ordinal_;
+    // per-document columns indexed by ordinal
+    std::vector<int> document_ids_;
+    std::vector<int> ratings_;
+    std::vector<DocumentStatus> statuses_;
+    // words of a document without stop words
+    std::vector<uint32_t> document_lengths_;
+    std::vector<TermCounts> ordinal_to_term_counts_;
+    // ordinals of the live documents of every status
+    std::array<DocumentBitmap, STATUS_COUNT> status_to_documents_;
+    // Postings of removed documents stay in term_to_postings_ until a term
+    // has more of them than live ones, then its list is rebuilt. Searches
+    // skip them as candidates.
+    std::vector<PostingList> term_to_postings_;
+    std::vector<uint32_t> term_to_removed_posting_count_;
+    // idf = log(document_count_) - log(document frequency), both logarithms
+    // are kept up to date by AddDocument and RemoveDocument
+    std::vector<double> term_to_log_document_freq_;
     int document_count_ = 0;
+    double log_document_count_ = 0.0;
+    uint64_t version_ = 0;
 
 public:
     SearchServer() = default;
@@ -59,56 +191,118 @@ public:
 
     explicit SearchServer(const std::string& stop_words_text);
 
-    void AddDocument(int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings);
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Tokenizes the batch in parallel and then adds all documents at once.
+    // Either every document is added or, if any of them is invalid, none.
+    void AddDocuments(std::span<const DocumentInput> documents);
 
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(
-            const std::string& raw_query, DocumentPredicate document_predicate) const {
-
-        std::vector<Document> top_documents;
-        top_documents.reserve(MAX_RESULT_DOCUMENT_COUNT);
-
-        std::vector<Document> all_documents = FindAllDocuments(raw_query);
-        std::sort(std::execution::par, 
-             all_documents.begin(), 
-             all_documents.end(), 
-             [](const Document& lhd, const Document& rhd) -> bool {
-                if(std::abs(lhd.relevance_ - rhd.relevance_) <= 
-                        EPSILON * std::max(std::abs(lhd.relevance_), std::abs(rhd.relevance_))) {
-                    return lhd.rating_ > rhd.rating_; 
-                }
-                return lhd.relevance_ > rhd.relevance_;
-             });
-
-        for(int i = 0; i < static_cast<int>(all_documents.size()); ++i) {
-            if(top_documents.size() == MAX_RESULT_DOCUMENT_COUNT) break;
-        
-            int id = all_documents[i].id_;
-            DocumentStatus status = all_documents[i].status_;
-            int rating = all_documents[i].rating_;
-
-            if(document_predicate(id, status, rating)) {
-                top_documents.push_back(all_documents[i]);
-            }
-        }
-        return top_documents;
+            std::string_view raw_query, DocumentPredicate document_predicate) const {
+        return FindTopDocumentsImpl(raw_query, document_predicate, nullptr);
     }
 
-    std::vector<Document> FindTopDocuments(const std::string& raw_query, DocumentStatus status) const;
+    // Scores documents with idf taken from corpus_statistics instead of this server.
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, 
+            const CorpusStatistics& corpus_statistics) const {
+        return FindTopDocumentsImpl(raw_query, document_predicate, &corpus_statistics);
+    }
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
-    std::vector<Document> FindTopDocuments(const std::string& raw_query) const;
+    // Documents [offset, offset + limit) in the order of IsBeforeInPages. Takes
+    // memory for offset + limit documents, so deep pages should use a cursor.
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, 
+            size_t limit, size_t offset) const;
+
+    // The first limit documents after the cursor in the order of IsBeforeInPages,
+    // SearchCursor::After of the last one continues with the next page.
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, 
+            size_t limit, const SearchCursor& after) const;
+
+    // The same as FindTopDocuments(query) for every query. Identical queries
+    // are searched once, every distinct word is looked up and gets its idf
+    // once per batch, and the postings of a word that several term-at-a-time
+    // queries share are decoded once. Distinct queries run in parallel.
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(std::span<const std::string> raw_queries) const;
+
+    // The same with the parallel parts run on the workers of executor.
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(QueryExecutor& executor, 
+            std::span<const std::string> raw_queries) const;
 
     int GetDocumentCount() const noexcept;
 
+    IndexStatistics GetIndexStatistics() const;
+
+    // changes whenever a document is added or removed
+    uint64_t GetVersion() const noexcept;
+
+    // Canonical form of a query: its distinct plus and minus words in a fixed
+    // order, without stop words and words no document contains. Queries with
+    // the same form return the same documents until the version changes.
+    std::string GetNormalizedQuery(std::string_view raw_query) const;
+
+    // number of documents containing the word
+    int GetDocumentFrequency(std::string_view word) const;
+
+    const std::set<std::string, std::less<>>& GetStopWords() const noexcept;
+
     std::tuple<std::vector<std::string>, DocumentStatus> 
-    MatchDocument(const std::string& raw_query, int document_id) const;
+    MatchDocument(std::string_view raw_query, int document_id) const;
 
-    const std::map<std::string, double>& GetWordFrequencies(int document_id) const;
+    // Built on every call from the document's term ids, as documents keep no
+    // word map of their own, so it is returned by value. The words view the
+    // dictionary and stay valid while the server lives; an unknown id gives
+    // an empty map.
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
     void RemoveDocument(int document_id);
 
-    using iterator = std::map<int, Document>::iterator;
-    using const_iterator = std::map<int, Document>::const_iterator;
+    // Removes all given documents at once, unknown ids are ignored.
+    void RemoveDocuments(std::span<const int> document_ids);
+
+    // Adds a document of another server with the same term frequencies, rating and status.
+    void CopyDocumentFrom(const SearchServer& source, int document_id);
+
+    // Walks documents in id order as (id, document) pairs.
+    class DocumentIterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = std::pair<int, Document>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type;
+
+        struct pointer {
+            value_type value_;
+            const value_type* operator->() const { return &value_; }
+        };
 
+        DocumentIterator() = default;
+        DocumentIterator(std::map<int, DocumentOrdinal>::const_iterator it, const SearchServer* search_server)
+            : it_(it), search_server_(search_server) {}
+
+        reference operator*() const { return {it_->first, search_server_->GetDocument(it_->second)}; }
+        pointer operator->() const { return {**this}; }
+
+        DocumentIterator& operator++() { ++it_; return *this; }
+        DocumentIterator operator++(int) { DocumentIterator old = *this; ++it_; return old; }
+        DocumentIterator& operator--() { --it_; return *this; }
+        DocumentIterator operator--(int) { DocumentIterator old = *this; --it_; return old; }
+
+        bool operator==(const DocumentIterator& other) const { return it_ == other.it_; }
+
+    private:
+        std::map<int, DocumentOrdinal>::const_iterator it_;
+        const SearchServer* search_server_ = nullptr;
+    };
+
+    using iterator = DocumentIterator;
+    using const_iterator = DocumentIterator;
 
     iterator begin() noexcept;
     iterator end() noexcept;
@@ -117,20 +311,104 @@ public:
     const_iterator cbegin() noexcept;
     const_iterator cend() noexcept;
 
+    // log(document_count) - log(document_frequency), zero for unknown words
+    static double ComputeIdf(int document_count, int document_frequency);
+
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+    // Exact relevance, then rating, then id. Unlike IsMoreRelevant this is a
+    // strict total order, so a page can start right after any document.
+    static bool IsBeforeInPages(const Document& lhs, const Document& rhs);
+
+    // Keeps top_documents a heap of at most MAX_RESULT_DOCUMENT_COUNT documents
+    // with the least relevant one on top, sort it with std::sort_heap and IsMoreRelevant.
+    static void PushTopDocument(std::vector<Document>& top_documents, const Document& document, double relevance);
+
 private:  
-    std::vector<std::string> SplitIntoWords(const std::string& text) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsImpl(std::string_view raw_query, DocumentPredicate document_predicate, 
+            const CorpusStatistics* corpus_statistics) const {
+
+        const std::function<bool(int, DocumentStatus, int)> predicate = document_predicate;
+        TopDocumentsSearch search;
+        search.document_predicate_ = &predicate;
+        return SearchTopDocuments(raw_query, corpus_statistics, std::move(search));
+    }
+
+    // The same documents as scoring every match and keeping the best limit_
+    // of search, found either term-at-a-time with the SIMD kernels or
+    // document-at-a-time with MaxScore pruning.
+    std::vector<Document> SearchTopDocuments(std::string_view raw_query, const CorpusStatistics* corpus_statistics, 
+            TopDocumentsSearch search) const;
+
+    // Scores search.terms_ without the words of query_terms that have them.
+    std::vector<Document> RunTopDocumentsSearch(const Query& query_terms, TopDocumentsSearch& search) const;
 
-    std::vector<std::string> SplitIntoWordsNoStop(const std::string& text) const;
+    // FindTopDocumentsBatch with parallel_for(count, task) running task(i)
+    // for every i in [0, count).
+    std::vector<std::vector<Document>> RunTopDocumentsBatch(std::span<const std::string> raw_queries, 
+            const std::function<void(size_t, const std::function<void(size_t)>&)>& parallel_for) const;
 
-    int GetRating(int document_id) const;
+    // MaxScore bounds only hold for non-negative contributions, and one or two
+    // dense posting lists are scored faster by the kernels than by merging.
+    static bool IsTermAtATimeFaster(const std::vector<ScoredTerm>& terms);
 
-    std::vector<Document> FindAllDocuments(const std::string& raw_query) const;
+    void ScoreTermAtATime(TopDocumentsSearch& search) const;
+
+    void ScoreWithMaxScore(TopDocumentsSearch& search) const;
+
+    // Filter and minus words. Ordinals must come in ascending order, the
+    // minus word cursors only move forward.
+    bool IsCandidate(TopDocumentsSearch& search, DocumentOrdinal ordinal) const;
+
+    // cursor and predicate, then the top
+    void OfferDocument(TopDocumentsSearch& search, DocumentOrdinal ordinal, double relevance) const;
+
+    // PushTopDocument with the limit and the order of search
+    static void PushTopDocument(TopDocumentsSearch& search, const Document& document, double relevance);
+
+    // Relevance below which a document can't enter a full top, whatever its rating.
+    static double GetMinCompetitiveRelevance(const TopDocumentsSearch& search);
+
+    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+
+    void CheckNewDocumentId(int document_id) const;
+
+    ParsedDocument ParseDocument(std::string_view document, const std::vector<int>& ratings) const;
+
+    void InsertDocument(int document_id, DocumentStatus status, const ParsedDocument& parsed_document);
+
+    void UpdateLogDocumentFreq(TermId term_id);
+
+    // postings of the term that belong to live documents
+    int CountLiveDocuments(TermId term_id) const;
+
+    void CompactOrdinals();
+
+    Document GetDocument(DocumentOrdinal ordinal) const;
+
+    double ComputeTermIdf(TermId term_id, const CorpusStatistics* corpus_statistics) const;
+
+    bool IsAllowed(DocumentOrdinal ordinal, const DocumentFilter* filter) const;
+
+    // live and allowed by the filter, the documents worth scoring
+    bool IsScorable(DocumentOrdinal ordinal, const DocumentFilter* filter) const;
+
+    double GetTf(DocumentOrdinal ordinal, uint32_t count) const;
+
+    // Re-encodes the postings of a term without removed documents, renumbered
+    // by old_to_new unless it is null. Removed documents map to NO_ORDINAL there.
+    void RebuildPostings(TermId term_id, const std::vector<DocumentOrdinal>* old_to_new);
 
     static int ComputeAverageRating(const std::vector<int>& rates);
 
-    void CheckUnacceptableSymbols(const std::string& word) const;
+    void CheckUnacceptableSymbols(std::string_view word) const;
+
+    Query ParseQuery(std::string_view raw_query) const;
+
+    static void NormalizeQuery(Query& query);
 
-    Query ParseQuery(const std::string& raw_query) const;
+    static bool ContainsTerm(const TermCounts& term_counts, TermId term_id);
 };
 
 std::ostream& operator<<(std::ostream& out, const SearchServer::Document& document);
@@ -0,0 +1,220 @@
+#include "segmented_search_server.h"
+#include <algorithm>
+#include <stdexcept>
+
+SegmentedSearchServer::SegmentedSearchServer(const std::string& stop_words_text, 
+                                             size_t segment_capacity, size_t merge_factor)
+    : stop_words_text_(stop_words_text)
+    , segment_capacity_(segment_capacity)
+    , merge_factor_(merge_factor)
+    , active_segment_{std::make_shared<SearchServer>(stop_words_text), {}}
+{
+    if(segment_capacity_ == 0 || merge_factor_ < 2) {
+        throw std::invalid_argument("segment capacity must be positive and merge factor at least 2!");
+    }
+    merge_thread_ = std::thread([this] { RunMerges(); });
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    {
+        std::unique_lock lock(mutex_);
+        stopping_ = true;
+    }
+    merge_requested_.notify_all();
+    merge_thread_.join();
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, std::string_view document, 
+                                        SearchServer::DocumentStatus status, const std::vector<int>& ratings) {
+    {
+        std::unique_lock lock(mutex_);
+        if(id_to_segment_.contains(document_id)) {
+            throw std::invalid_argument("document already exists!");
+        }
+
+        active_segment_.index_->AddDocument(document_id, document, status, ratings);
+        id_to_segment_[document_id] = active_segment_.index_.get();
+        UpdateDocumentCounts(*active_segment_.index_, document_id, 1);
+
+        if(static_cast<size_t>(active_segment_.index_->GetDocumentCount()) < segment_capacity_) {
+            return;
+        }
+        SealActiveSegment();
+        if(!FindFullTier()) {
+            return;
+        }
+    }
+    merge_requested_.notify_one();
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    std::unique_lock lock(mutex_);
+    auto it = id_to_segment_.find(document_id);
+    if(it == id_to_segment_.end()) {
+        return;
+    }
+
+    UpdateDocumentCounts(*it->second, document_id, -1);
+    if(it->second == active_segment_.index_.get()) {
+        // the active segment is small, so it is cheaper to delete right away
+        // and this keeps the id free for a new document
+        active_segment_.index_->RemoveDocument(document_id);
+    } else {
+        for(Segment& segment : sealed_segments_) {
+            if(segment.index_.get() == it->second) {
+                segment.deleted_ids_.insert(document_id);
+                break;
+            }
+        }
+    }
+    id_to_segment_.erase(it);
+}
+
+std::vector<SearchServer::Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status) const {
+    auto pred = [status](int id, SearchServer::DocumentStatus s, int r) {
+        return s == status;
+    };
+
+    return FindTopDocuments(raw_query, pred);
+}
+
+std::vector<SearchServer::Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, SearchServer::DocumentStatus::ACTUAL);
+}
+
+int SegmentedSearchServer::GetDocumentCount() const {
+    std::shared_lock lock(mutex_);
+    return static_cast<int>(id_to_segment_.size());
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    std::shared_lock lock(mutex_);
+    return sealed_segments_.size() + 1;
+}
+
+std::tuple<std::vector<std::string>, SearchServer::DocumentStatus> 
+SegmentedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    std::shared_lock lock(mutex_);
+    return id_to_segment_.at(document_id)->MatchDocument(raw_query, document_id);
+}
+
+void SegmentedSearchServer::MergeSegments() {
+    std::lock_guard merge_lock(merge_mutex_);
+
+    std::vector<Segment> merged_segments;
+    {
+        std::shared_lock lock(mutex_);
+        merged_segments = sealed_segments_;
+    }
+    if(merged_segments.size() >= 2) {
+        MergeSealedSegments(merged_segments);
+    }
+}
+
+SearchServer::CorpusStatistics SegmentedSearchServer::GetCorpusStatistics() const {
+    return {
+        static_cast<int>(id_to_segment_.size()),
+        [this](std::string_view word) {
+            auto it = word_to_document_count_.find(word);
+            return it == word_to_document_count_.end() ? 0 : it->second;
+        }
+    };
+}
+
+void SegmentedSearchServer::UpdateDocumentCounts(const SearchServer& segment, int document_id, int delta) {
+    for(const auto& [word, _] : segment.GetWordFrequencies(document_id)) {
+        auto it = word_to_document_count_.find(word);
+        if(it == word_to_document_count_.end()) {
+            it = word_to_document_count_.emplace(std::string(word), 0).first;
+        }
+        it->second += delta;
+        if(it->second == 0) {
+            word_to_document_count_.erase(it);
+        }
+    }
+}
+
+void SegmentedSearchServer::SealActiveSegment() {
+    sealed_segments_.push_back(std::move(active_segment_));
+    active_segment_ = {std::make_shared<SearchServer>(stop_words_text_), {}};
+}
+
+std::optional<size_t> SegmentedSearchServer::FindFullTier() const {
+    std::map<size_t, size_t> tier_to_segment_count;
+    for(const Segment& segment : sealed_segments_) {
+        ++tier_to_segment_count[segment.tier_];
+    }
+    for(const auto& [tier, segment_count] : tier_to_segment_count) {
+        if(segment_count >= merge_factor_) {
+            return tier;
+        }
+    }
+    return std::nullopt;
+}
+
+void SegmentedSearchServer::MergeSealedSegments(const std::vector<Segment>& merged_segments) {
+    // sealed segments are never modified, only their tombstones, so they can
+    // be read without holding mutex_ once the tombstones are copied
+    auto merged_index = std::make_shared<SearchServer>(stop_words_text_);
+    size_t merged_tier = 0;
+    for(const Segment& segment : merged_segments) {
+        for(const auto& [document_id, document] : *segment.index_) {
+            if(!segment.deleted_ids_.contains(document_id)) {
+                merged_index->CopyDocumentFrom(*segment.index_, document_id);
+            }
+        }
+        merged_tier = std::max(merged_tier, segment.tier_ + 1);
+    }
+
+    std::unique_lock lock(mutex_);
+    Segment merged{merged_index, {}, merged_tier};
+    // documents removed while the merge was running are still in merged_index
+    for(const Segment& merged_segment : merged_segments) {
+        auto it = std::find_if(sealed_segments_.begin(), sealed_segments_.end(), [&merged_segment](const Segment& segment) {
+            return segment.index_ == merged_segment.index_;
+        });
+        for(int document_id : it->deleted_ids_) {
+            if(!merged_segment.deleted_ids_.contains(document_id)) {
+                merged.deleted_ids_.insert(document_id);
+            }
+        }
+        sealed_segments_.erase(it);
+    }
+    for(const auto& [document_id, document] : *merged_index) {
+        if(!merged.deleted_ids_.contains(document_id)) {
+            id_to_segment_[document_id] = merged_index.get();
+        }
+    }
+    sealed_segments_.push_back(std::move(merged));
+}
+
+void SegmentedSearchServer::RunMerges() {
+    while(true) {
+        {
+            std::unique_lock lock(mutex_);
+            merge_requested_.wait(lock, [this] {
+                return stopping_ || FindFullTier().has_value();
+            });
+            if(stopping_) {
+                return;
+            }
+        }
+
+        std::lock_guard merge_lock(merge_mutex_);
+        std::vector<Segment> merged_segments;
+        {
+            // an on-demand merge may have taken the segments in the meantime
+            std::shared_lock lock(mutex_);
+            const std::optional<size_t> tier = FindFullTier();
+            if(!tier) {
+                continue;
+            }
+            for(const Segment& segment : sealed_segments_) {
+                if(segment.tier_ == *tier && merged_segments.size() < merge_factor_) {
+                    merged_segments.push_back(segment);
+                }
+            }
+        }
+        MergeSealedSegments(merged_segments);
+    }
+}
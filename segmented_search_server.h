@@ -0,0 +1,119 @@
+#pragma once
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "search_server.h"
+
+// Index split into SearchServer segments. New documents go to a small
+// mutable segment that is sealed once it holds segment_capacity documents.
+// Removing a document from a sealed segment only records a tombstone that
+// queries check. Sealed segments are kept in tiers: a sealed segment is in
+// tier 0, and merging merge_factor segments of tier k, dropping their
+// tombstoned documents, gives one segment of tier k + 1. A background
+// thread merges whenever a tier has merge_factor segments, so a document
+// is copied once per tier and merge cost doesn't grow with the index.
+// Relevance is computed from corpus-wide document frequencies of the live
+// documents, so it does not depend on how documents are spread over segments.
+class SegmentedSearchServer {
+public:
+    explicit SegmentedSearchServer(const std::string& stop_words_text, 
+                                   size_t segment_capacity = 10000, size_t merge_factor = 4);
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+    ~SegmentedSearchServer();
+
+    void AddDocument(int document_id, std::string_view document, 
+                     SearchServer::DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate>
+    std::vector<SearchServer::Document> FindTopDocuments(
+            std::string_view raw_query, DocumentPredicate document_predicate) const {
+        std::shared_lock lock(mutex_);
+
+        const SearchServer::CorpusStatistics corpus_statistics = GetCorpusStatistics();
+        std::vector<SearchServer::Document> top_documents;
+        top_documents.reserve(MAX_RESULT_DOCUMENT_COUNT + 1);
+
+        auto search_segment = [&](const Segment& segment) {
+            auto is_live = [&segment, &document_predicate](int id, SearchServer::DocumentStatus status, int rating) {
+                return !segment.deleted_ids_.contains(id) && document_predicate(id, status, rating);
+            };
+            for(const SearchServer::Document& document : 
+                    segment.index_->FindTopDocuments(raw_query, is_live, corpus_statistics)) {
+                SearchServer::PushTopDocument(top_documents, document, document.relevance_);
+            }
+        };
+        for(const Segment& segment : sealed_segments_) {
+            search_segment(segment);
+        }
+        search_segment(active_segment_);
+
+        std::sort_heap(top_documents.begin(), top_documents.end(), SearchServer::IsMoreRelevant);
+        return top_documents;
+    }
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status) const;
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+    size_t GetSegmentCount() const;
+
+    std::tuple<std::vector<std::string>, SearchServer::DocumentStatus> 
+    MatchDocument(std::string_view raw_query, int document_id) const;
+
+    // Merges all sealed segments into one right away, to compact the index
+    // on demand. The background thread only merges full tiers.
+    void MergeSegments();
+
+private:
+    struct Segment {
+        std::shared_ptr<SearchServer> index_;
+        // documents still stored in index_ that were removed
+        std::unordered_set<int> deleted_ids_;
+        size_t tier_ = 0;
+    };
+
+    const std::string stop_words_text_;
+    const size_t segment_capacity_;
+    const size_t merge_factor_;
+
+    mutable std::shared_mutex mutex_;
+    Segment active_segment_;
+    std::vector<Segment> sealed_segments_;
+    std::unordered_map<int, const SearchServer*> id_to_segment_;
+    std::map<std::string, int, std::less<>> word_to_document_count_;
+
+    std::mutex merge_mutex_;
+    std::condition_variable_any merge_requested_;
+    bool stopping_ = false;
+    std::thread merge_thread_;
+
+    SearchServer::CorpusStatistics GetCorpusStatistics() const;
+
+    void UpdateDocumentCounts(const SearchServer& segment, int document_id, int delta);
+
+    void SealActiveSegment();
+
+    // the lowest tier with at least merge_factor_ segments
+    std::optional<size_t> FindFullTier() const;
+
+    // Replaces segments, which must be sealed, with one segment holding
+    // their live documents. The caller holds merge_mutex_.
+    void MergeSealedSegments(const std::vector<Segment>& merged_segments);
+
+    void RunMerges();
+};
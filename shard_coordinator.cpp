@@ -0,0 +1,209 @@
+#include "shard_coordinator.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace shard_protocol;
+
+ShardCoordinator::ShardCoordinator(const std::vector<std::string>& endpoints) {
+    if(endpoints.empty()) {
+        throw std::invalid_argument("coordinator needs at least one shard!");
+    }
+    shards_.reserve(endpoints.size());
+    for(const std::string& endpoint : endpoints) {
+        shards_.push_back(ConnectTo(endpoint));
+    }
+
+    MessageWriter writer;
+    writer.WriteUint8(static_cast<uint8_t>(RequestType::GET_STOP_WORDS));
+    const std::string response = Call(0, writer.GetPayload());
+    MessageReader reader(response);
+    CheckResponse(reader);
+    for(uint32_t count = reader.ReadCount(sizeof(uint32_t)); count > 0; --count) {
+        stop_words_.emplace(reader.ReadString());
+    }
+}
+
+void ShardCoordinator::AddDocument(int document_id, std::string_view document,
+                                   SearchServer::DocumentStatus status, const std::vector<int>& ratings) {
+    if(document_id < 0) {
+        throw std::invalid_argument("document_id can't be less than 0!");
+    }
+    MessageWriter writer;
+    writer.WriteUint8(static_cast<uint8_t>(RequestType::ADD_DOCUMENT));
+    writer.WriteInt32(document_id);
+    writer.WriteUint8(static_cast<uint8_t>(status));
+    writer.WriteUint32(static_cast<uint32_t>(ratings.size()));
+    for(int rating : ratings) {
+        writer.WriteInt32(rating);
+    }
+    writer.WriteString(document);
+
+    const std::string response = Call(GetShardIndex(document_id), writer.GetPayload());
+    MessageReader reader(response);
+    CheckResponse(reader);
+}
+
+void ShardCoordinator::RemoveDocument(int document_id) {
+    if(document_id < 0) {
+        return;
+    }
+    MessageWriter writer;
+    writer.WriteUint8(static_cast<uint8_t>(RequestType::REMOVE_DOCUMENT));
+    writer.WriteInt32(document_id);
+
+    const std::string response = Call(GetShardIndex(document_id), writer.GetPayload());
+    MessageReader reader(response);
+    CheckResponse(reader);
+}
+
+std::vector<SearchServer::Document> ShardCoordinator::FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status) const {
+    std::vector<std::string_view> words;
+    auto is_stop_word = [this](std::string_view word) {
+        return stop_words_.contains(word);
+    };
+    ForEachQueryWord(raw_query, is_stop_word, [&words](std::string_view word, bool) {
+        if(std::find(words.begin(), words.end(), word) == words.end()) {
+            words.push_back(word);
+        }
+    });
+
+    MessageWriter statistics_request;
+    statistics_request.WriteUint8(static_cast<uint8_t>(RequestType::GET_TERM_STATISTICS));
+    statistics_request.WriteUint32(static_cast<uint32_t>(words.size()));
+    for(std::string_view word : words) {
+        statistics_request.WriteString(word);
+    }
+    int document_count = 0;
+    std::vector<int> document_frequencies(words.size(), 0);
+    for(const std::string& response : Broadcast(statistics_request.GetPayload())) {
+        MessageReader reader(response);
+        CheckResponse(reader);
+        document_count += reader.ReadInt32();
+        for(int& document_frequency : document_frequencies) {
+            document_frequency += reader.ReadInt32();
+        }
+    }
+
+    MessageWriter search_request;
+    search_request.WriteUint8(static_cast<uint8_t>(RequestType::FIND_TOP_DOCUMENTS));
+    search_request.WriteString(raw_query);
+    search_request.WriteUint8(static_cast<uint8_t>(status));
+    search_request.WriteInt32(document_count);
+    search_request.WriteUint32(static_cast<uint32_t>(words.size()));
+    for(size_t i = 0; i < words.size(); ++i) {
+        search_request.WriteString(words[i]);
+        search_request.WriteInt32(document_frequencies[i]);
+    }
+    std::vector<SearchServer::Document> top_documents;
+    top_documents.reserve(MAX_RESULT_DOCUMENT_COUNT + 1);
+    for(const std::string& response : Broadcast(search_request.GetPayload())) {
+        MessageReader reader(response);
+        CheckResponse(reader);
+        for(uint32_t count = reader.ReadUint32(); count > 0; --count) {
+            const SearchServer::Document document = ReadDocument(reader);
+            SearchServer::PushTopDocument(top_documents, document, document.relevance_);
+        }
+    }
+    std::sort_heap(top_documents.begin(), top_documents.end(), SearchServer::IsMoreRelevant);
+    return top_documents;
+}
+
+std::vector<SearchServer::Document> ShardCoordinator::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, SearchServer::DocumentStatus::ACTUAL);
+}
+
+int ShardCoordinator::GetDocumentCount() const {
+    MessageWriter writer;
+    writer.WriteUint8(static_cast<uint8_t>(RequestType::GET_TERM_STATISTICS));
+    writer.WriteUint32(0);
+
+    int document_count = 0;
+    for(const std::string& response : Broadcast(writer.GetPayload())) {
+        MessageReader reader(response);
+        CheckResponse(reader);
+        document_count += reader.ReadInt32();
+    }
+    return document_count;
+}
+
+size_t ShardCoordinator::GetShardCount() const noexcept {
+    return shards_.size();
+}
+
+std::tuple<std::vector<std::string>, SearchServer::DocumentStatus>
+ShardCoordinator::MatchDocument(std::string_view raw_query, int document_id) const {
+    if(document_id < 0) {
+        throw std::out_of_range("document doesn't exist!");
+    }
+    MessageWriter writer;
+    writer.WriteUint8(static_cast<uint8_t>(RequestType::MATCH_DOCUMENT));
+    writer.WriteString(raw_query);
+    writer.WriteInt32(document_id);
+
+    const std::string response = Call(GetShardIndex(document_id), writer.GetPayload());
+    MessageReader reader(response);
+    CheckResponse(reader);
+    std::vector<std::string> words(reader.ReadCount(sizeof(uint32_t)));
+    for(std::string& word : words) {
+        word = reader.ReadString();
+    }
+    const SearchServer::DocumentStatus status = reader.ReadDocumentStatus();
+    return {words, status};
+}
+
+void ShardCoordinator::Shutdown() {
+    MessageWriter writer;
+    writer.WriteUint8(static_cast<uint8_t>(RequestType::SHUTDOWN));
+    for(const std::string& response : Broadcast(writer.GetPayload())) {
+        MessageReader reader(response);
+        CheckResponse(reader);
+    }
+    shards_.clear();
+}
+
+size_t ShardCoordinator::GetShardIndex(int document_id) const {
+    CheckNotShutDown();
+    return static_cast<size_t>(document_id) % shards_.size();
+}
+
+void ShardCoordinator::CheckNotShutDown() const {
+    if(shards_.empty()) {
+        throw std::runtime_error("coordinator is shut down");
+    }
+}
+
+std::string ShardCoordinator::Call(size_t shard_index, std::string_view request) const {
+    CheckNotShutDown();
+    try {
+        SendMessage(shards_[shard_index], request);
+        std::string response;
+        if(!ReceiveMessage(shards_[shard_index], response)) {
+            throw std::runtime_error("shard connection closed");
+        }
+        return response;
+    } catch(...) {
+        shards_.clear();
+        throw;
+    }
+}
+
+std::vector<std::string> ShardCoordinator::Broadcast(std::string_view request) const {
+    CheckNotShutDown();
+    try {
+        for(const Socket& shard : shards_) {
+            SendMessage(shard, request);
+        }
+        std::vector<std::string> responses(shards_.size());
+        for(size_t i = 0; i < shards_.size(); ++i) {
+            if(!ReceiveMessage(shards_[i], responses[i])) {
+                throw std::runtime_error("shard connection closed");
+            }
+        }
+        return responses;
+    } catch(...) {
+        // the other nodes may still answer, their responses must not be
+        // taken for the ones of a later request
+        shards_.clear();
+        throw;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "search_server.h"
+#include "shard_protocol.h"
+
+// Client of a distributed index served by ShardNodes, one connection per
+// node. Document id goes to node id % node count, like in
+// ShardedSearchServer. A query takes two round trips to every node: the
+// first one collects the document frequencies of its words, the second one
+// scores it on every node with their sums, so relevance is the one of a
+// single SearchServer holding every document up to rounding, as in
+// ShardedSearchServer. Requests are sent to all nodes before any response
+// is read, so the nodes work in parallel.
+// Queries are parsed with the stop words of the first node, fetched once on
+// construction. A coordinator is used by one thread at a time, concurrent clients use
+// coordinators of their own.
+class ShardCoordinator {
+public:
+    explicit ShardCoordinator(const std::vector<std::string>& endpoints);
+
+    void AddDocument(int document_id, std::string_view document,
+                     SearchServer::DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status) const;
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+    size_t GetShardCount() const noexcept;
+
+    std::tuple<std::vector<std::string>, SearchServer::DocumentStatus>
+    MatchDocument(std::string_view raw_query, int document_id) const;
+
+    // Asks every node to stop and closes the connections.
+    void Shutdown();
+
+private:
+    // empty once shut down, connections are closed by failed requests too
+    mutable std::vector<shard_protocol::Socket> shards_;
+    // of the first node, every node is expected to have the same ones
+    std::set<std::string, std::less<>> stop_words_;
+
+    size_t GetShardIndex(int document_id) const;
+
+    // throws std::runtime_error once the coordinator is shut down
+    void CheckNotShutDown() const;
+
+    // Request to one node and its response, checked by the caller with
+    // CheckResponse. A failed connection may leave responses of other
+    // requests unread, so it closes every connection and throws
+    // std::runtime_error. Later requests then throw as after Shutdown.
+    std::string Call(size_t shard_index, std::string_view request) const;
+
+    // the same request to every node, responses in node order
+    std::vector<std::string> Broadcast(std::string_view request) const;
+};
@@ -0,0 +1,184 @@
+#include "shard_node.h"
+#include <cerrno>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <sys/socket.h>
+
+using namespace std::string_literals;
+using namespace shard_protocol;
+
+ShardNode::ShardNode(SearchServer search_server, const std::string& endpoint)
+    : search_server_(std::move(search_server))
+    , listener_(ListenOn(endpoint))
+    , endpoint_(GetLocalEndpoint(listener_))
+{}
+
+void ShardNode::Serve() {
+    std::list<ConnectionThread> connection_threads;
+    while(!stopping_) {
+        Socket connection(::accept(listener_.GetFd(), nullptr, nullptr));
+        if(!connection.IsOpen()) {
+            if(errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            // Stop shuts the listener down, which fails the accept
+            break;
+        }
+        JoinFinishedThreads(connection_threads);
+        ConnectionThread& connection_thread = connection_threads.emplace_back();
+        connection_thread.thread_ = std::thread([this, &connection_thread, connection = std::move(connection)]() mutable {
+            ServeConnection(std::move(connection));
+            connection_thread.finished_.store(true, std::memory_order_release);
+        });
+    }
+    for(ConnectionThread& connection_thread : connection_threads) {
+        connection_thread.thread_.join();
+    }
+}
+
+const std::string& ShardNode::GetEndpoint() const noexcept {
+    return endpoint_;
+}
+
+void ShardNode::ServeConnection(Socket connection) {
+    // a broken connection only ends itself, the coordinator reports it
+    try {
+        std::string request;
+        while(ReceiveMessage(connection, request)) {
+            MessageReader reader(request);
+            std::string response;
+            try {
+                response = HandleRequest(reader);
+            } catch(...) {
+                response = MakeErrorResponse(std::current_exception());
+            }
+            SendMessage(connection, response);
+            if(static_cast<RequestType>(request[0]) == RequestType::SHUTDOWN) {
+                Stop();
+            }
+        }
+    } catch(const std::exception& e) {
+        std::cerr << "Shard connection failed: "s << e.what() << std::endl;
+    }
+}
+
+std::string ShardNode::HandleRequest(MessageReader& reader) {
+    MessageWriter writer;
+    const RequestType type = static_cast<RequestType>(reader.ReadUint8());
+    switch(type) {
+    case RequestType::ADD_DOCUMENT: {
+        const int document_id = reader.ReadInt32();
+        const SearchServer::DocumentStatus status = reader.ReadDocumentStatus();
+        std::vector<int> ratings(reader.ReadCount(sizeof(int32_t)));
+        for(int& rating : ratings) {
+            rating = reader.ReadInt32();
+        }
+        const std::string_view text = reader.ReadString();
+        std::unique_lock lock(mutex_);
+        search_server_.AddDocument(document_id, text, status, ratings);
+        break;
+    }
+    case RequestType::REMOVE_DOCUMENT: {
+        const int document_id = reader.ReadInt32();
+        std::unique_lock lock(mutex_);
+        search_server_.RemoveDocument(document_id);
+        break;
+    }
+    case RequestType::GET_TERM_STATISTICS: {
+        std::vector<std::string_view> words(reader.ReadCount(sizeof(uint32_t)));
+        for(std::string_view& word : words) {
+            word = reader.ReadString();
+        }
+        std::shared_lock lock(mutex_);
+        writer.WriteUint8(static_cast<uint8_t>(ResponseStatus::OK));
+        writer.WriteInt32(search_server_.GetDocumentCount());
+        for(std::string_view word : words) {
+            writer.WriteInt32(search_server_.GetDocumentFrequency(word));
+        }
+        return writer.GetPayload();
+    }
+    case RequestType::FIND_TOP_DOCUMENTS: {
+        const std::string_view raw_query = reader.ReadString();
+        const SearchServer::DocumentStatus status = reader.ReadDocumentStatus();
+        const int document_count = reader.ReadInt32();
+        // a word is at least its size, then comes its int32 count
+        std::vector<std::pair<std::string_view, int>> word_to_document_count(
+            reader.ReadCount(sizeof(uint32_t) + sizeof(int32_t)));
+        for(auto& [word, count] : word_to_document_count) {
+            word = reader.ReadString();
+            count = reader.ReadInt32();
+        }
+        const SearchServer::CorpusStatistics corpus_statistics = {
+            document_count,
+            [&word_to_document_count](std::string_view word) {
+                for(const auto& [known_word, count] : word_to_document_count) {
+                    if(known_word == word) {
+                        return count;
+                    }
+                }
+                return 0;
+            }
+        };
+        auto pred = [status](int id, SearchServer::DocumentStatus s, int r) {
+            return s == status;
+        };
+
+        std::shared_lock lock(mutex_);
+        const std::vector<SearchServer::Document> documents =
+            search_server_.FindTopDocuments(raw_query, pred, corpus_statistics);
+        lock.unlock();
+        writer.WriteUint8(static_cast<uint8_t>(ResponseStatus::OK));
+        writer.WriteUint32(static_cast<uint32_t>(documents.size()));
+        for(const SearchServer::Document& document : documents) {
+            WriteDocument(writer, document);
+        }
+        return writer.GetPayload();
+    }
+    case RequestType::MATCH_DOCUMENT: {
+        const std::string_view raw_query = reader.ReadString();
+        const int document_id = reader.ReadInt32();
+        std::shared_lock lock(mutex_);
+        const auto [words, status] = search_server_.MatchDocument(raw_query, document_id);
+        lock.unlock();
+        writer.WriteUint8(static_cast<uint8_t>(ResponseStatus::OK));
+        writer.WriteUint32(static_cast<uint32_t>(words.size()));
+        for(const std::string& word : words) {
+            writer.WriteString(word);
+        }
+        writer.WriteUint8(static_cast<uint8_t>(status));
+        return writer.GetPayload();
+    }
+    case RequestType::GET_STOP_WORDS: {
+        // stop words never change, the lock is not needed
+        const std::set<std::string, std::less<>>& stop_words = search_server_.GetStopWords();
+        writer.WriteUint8(static_cast<uint8_t>(ResponseStatus::OK));
+        writer.WriteUint32(static_cast<uint32_t>(stop_words.size()));
+        for(const std::string& stop_word : stop_words) {
+            writer.WriteString(stop_word);
+        }
+        return writer.GetPayload();
+    }
+    case RequestType::SHUTDOWN:
+        break;
+    default:
+        throw std::invalid_argument("unknown shard request "s + std::to_string(static_cast<int>(type)));
+    }
+    writer.WriteUint8(static_cast<uint8_t>(ResponseStatus::OK));
+    return writer.GetPayload();
+}
+
+void ShardNode::JoinFinishedThreads(std::list<ConnectionThread>& connection_threads) {
+    std::erase_if(connection_threads, [](ConnectionThread& connection_thread) {
+        if(!connection_thread.finished_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        connection_thread.thread_.join();
+        return true;
+    });
+}
+
+void ShardNode::Stop() {
+    stopping_ = true;
+    ::shutdown(listener_.GetFd(), SHUT_RDWR);
+}
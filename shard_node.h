@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "search_server.h"
+#include "shard_protocol.h"
+
+// Serves one shard of a distributed index to ShardCoordinators over the
+// shard protocol. The node listens from construction on, so coordinators
+// can connect before Serve is called. Every connection is served on its
+// own thread, queries of different connections run concurrently and
+// changes to the index wait for them.
+class ShardNode {
+public:
+    ShardNode(SearchServer search_server, const std::string& endpoint);
+    ShardNode(const ShardNode&) = delete;
+    ShardNode& operator=(const ShardNode&) = delete;
+
+    // Accepts connections until a SHUTDOWN request, then returns once every
+    // connection has been closed by its coordinator.
+    void Serve();
+
+    // the endpoint the node listens on, with the actual port for tcp port 0
+    const std::string& GetEndpoint() const noexcept;
+
+private:
+    struct ConnectionThread {
+        std::thread thread_;
+        // set by the thread once it no longer touches the node
+        std::atomic<bool> finished_ = false;
+    };
+
+    SearchServer search_server_;
+    mutable std::shared_mutex mutex_;
+    shard_protocol::Socket listener_;
+    std::string endpoint_;
+    std::atomic<bool> stopping_ = false;
+
+    void ServeConnection(shard_protocol::Socket connection);
+
+    // joins the threads of connections that were closed
+    static void JoinFinishedThreads(std::list<ConnectionThread>& connection_threads);
+
+    std::string HandleRequest(shard_protocol::MessageReader& reader);
+
+    void Stop();
+};
@@ -0,0 +1,393 @@
+#include "shard_protocol.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std::string_literals;
+
+namespace shard_protocol {
+    namespace {
+        constexpr std::string_view UNIX_PREFIX = "unix:";
+        constexpr std::string_view TCP_PREFIX = "tcp:";
+
+        [[noreturn]] void ThrowSystemError(const std::string& what) {
+            throw std::runtime_error(what + ": "s + std::strerror(errno));
+        }
+
+        sockaddr_un MakeUnixAddress(std::string_view path) {
+            sockaddr_un address = {};
+            address.sun_family = AF_UNIX;
+            if(path.empty() || path.size() >= sizeof(address.sun_path)) {
+                throw std::invalid_argument("invalid unix socket path "s + std::string(path));
+            }
+            std::memcpy(address.sun_path, path.data(), path.size());
+            return address;
+        }
+
+        // host and port of "tcp:<host>:<port>", resolved to IPv4 or IPv6
+        addrinfo* ResolveTcpAddress(std::string_view host_port, bool passive) {
+            const size_t colon = host_port.rfind(':');
+            if(colon == std::string_view::npos || colon + 1 == host_port.size()) {
+                throw std::invalid_argument("tcp endpoint needs a port: "s + std::string(host_port));
+            }
+            const std::string host(host_port.substr(0, colon));
+            const std::string port(host_port.substr(colon + 1));
+
+            addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = passive ? AI_PASSIVE : 0;
+            addrinfo* addresses = nullptr;
+            if(int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &addresses); error != 0) {
+                throw std::runtime_error("can't resolve "s + std::string(host_port) + ": "s + gai_strerror(error));
+            }
+            return addresses;
+        }
+
+        // tries every address of a tcp endpoint until setup succeeds on one
+        template <typename Setup>
+        Socket OpenTcpSocket(std::string_view host_port, bool passive, Setup setup) {
+            addrinfo* addresses = ResolveTcpAddress(host_port, passive);
+            int last_errno = 0;
+            for(addrinfo* address = addresses; address != nullptr; address = address->ai_next) {
+                Socket socket(::socket(address->ai_family, address->ai_socktype, address->ai_protocol));
+                if(socket.IsOpen() && setup(socket, *address)) {
+                    freeaddrinfo(addresses);
+                    return socket;
+                }
+                last_errno = errno;
+            }
+            freeaddrinfo(addresses);
+            errno = last_errno;
+            ThrowSystemError("can't open tcp socket "s + std::string(host_port));
+        }
+
+        void SetNoDelay(const Socket& socket) {
+            int enable = 1;
+            setsockopt(socket.GetFd(), IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+
+        // false if the peer closed the connection before the first byte
+        bool ReceiveBytes(const Socket& socket, char* data, size_t size) {
+            size_t received = 0;
+            while(received < size) {
+                const ssize_t count = ::recv(socket.GetFd(), data + received, size - received, 0);
+                if(count == 0) {
+                    if(received == 0) {
+                        return false;
+                    }
+                    throw std::runtime_error("shard connection closed in the middle of a message");
+                }
+                if(count < 0) {
+                    if(errno == EINTR) {
+                        continue;
+                    }
+                    ThrowSystemError("can't receive from shard connection");
+                }
+                received += static_cast<size_t>(count);
+            }
+            return true;
+        }
+    }
+
+    void MessageWriter::WriteUint8(uint8_t value) {
+        WriteBytes(&value, sizeof(value));
+    }
+
+    void MessageWriter::WriteInt32(int32_t value) {
+        WriteBytes(&value, sizeof(value));
+    }
+
+    void MessageWriter::WriteUint32(uint32_t value) {
+        WriteBytes(&value, sizeof(value));
+    }
+
+    void MessageWriter::WriteDouble(double value) {
+        WriteBytes(&value, sizeof(value));
+    }
+
+    void MessageWriter::WriteString(std::string_view value) {
+        WriteUint32(static_cast<uint32_t>(value.size()));
+        WriteBytes(value.data(), value.size());
+    }
+
+    const std::string& MessageWriter::GetPayload() const noexcept {
+        return payload_;
+    }
+
+    void MessageWriter::WriteBytes(const void* data, size_t size) {
+        payload_.append(static_cast<const char*>(data), size);
+    }
+
+    MessageReader::MessageReader(std::string_view payload)
+        : payload_(payload)
+    {}
+
+    uint8_t MessageReader::ReadUint8() {
+        uint8_t value;
+        ReadBytes(&value, sizeof(value));
+        return value;
+    }
+
+    int32_t MessageReader::ReadInt32() {
+        int32_t value;
+        ReadBytes(&value, sizeof(value));
+        return value;
+    }
+
+    uint32_t MessageReader::ReadUint32() {
+        uint32_t value;
+        ReadBytes(&value, sizeof(value));
+        return value;
+    }
+
+    double MessageReader::ReadDouble() {
+        double value;
+        ReadBytes(&value, sizeof(value));
+        return value;
+    }
+
+    std::string_view MessageReader::ReadString() {
+        const uint32_t size = ReadUint32();
+        if(payload_.size() - pos_ < size) {
+            throw std::runtime_error("truncated shard message");
+        }
+        std::string_view value = payload_.substr(pos_, size);
+        pos_ += size;
+        return value;
+    }
+
+    uint32_t MessageReader::ReadCount(size_t min_element_size) {
+        const uint32_t count = ReadUint32();
+        if(count > (payload_.size() - pos_) / min_element_size) {
+            throw std::runtime_error("shard message list is longer than the message");
+        }
+        return count;
+    }
+
+    SearchServer::DocumentStatus MessageReader::ReadDocumentStatus() {
+        const uint8_t status = ReadUint8();
+        if(status > static_cast<uint8_t>(SearchServer::DocumentStatus::REMOVED)) {
+            throw std::invalid_argument("unknown document status "s + std::to_string(status));
+        }
+        return static_cast<SearchServer::DocumentStatus>(status);
+    }
+
+    bool MessageReader::IsEnd() const noexcept {
+        return pos_ == payload_.size();
+    }
+
+    void MessageReader::ReadBytes(void* data, size_t size) {
+        if(payload_.size() - pos_ < size) {
+            throw std::runtime_error("truncated shard message");
+        }
+        std::memcpy(data, payload_.data() + pos_, size);
+        pos_ += size;
+    }
+
+    Socket::Socket(int fd) noexcept
+        : fd_(fd)
+    {}
+
+    Socket::Socket(Socket&& other) noexcept
+        : fd_(std::exchange(other.fd_, -1))
+    {}
+
+    Socket& Socket::operator=(Socket&& other) noexcept {
+        if(this != &other) {
+            Close();
+            fd_ = std::exchange(other.fd_, -1);
+        }
+        return *this;
+    }
+
+    Socket::~Socket() {
+        Close();
+    }
+
+    int Socket::GetFd() const noexcept {
+        return fd_;
+    }
+
+    bool Socket::IsOpen() const noexcept {
+        return fd_ >= 0;
+    }
+
+    void Socket::Close() noexcept {
+        if(fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    Socket ListenOn(const std::string& endpoint) {
+        const std::string_view view = endpoint;
+        if(view.starts_with(UNIX_PREFIX)) {
+            const std::string path(view.substr(UNIX_PREFIX.size()));
+            const sockaddr_un address = MakeUnixAddress(path);
+            Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+            if(!socket.IsOpen()) {
+                ThrowSystemError("can't create unix socket"s);
+            }
+            ::unlink(path.c_str());
+            if(::bind(socket.GetFd(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+                    || ::listen(socket.GetFd(), SOMAXCONN) != 0) {
+                ThrowSystemError("can't listen on "s + endpoint);
+            }
+            return socket;
+        }
+        if(view.starts_with(TCP_PREFIX)) {
+            return OpenTcpSocket(view.substr(TCP_PREFIX.size()), true, [](const Socket& socket, const addrinfo& address) {
+                int enable = 1;
+                setsockopt(socket.GetFd(), SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+                return ::bind(socket.GetFd(), address.ai_addr, address.ai_addrlen) == 0
+                    && ::listen(socket.GetFd(), SOMAXCONN) == 0;
+            });
+        }
+        throw std::invalid_argument("unknown endpoint "s + endpoint);
+    }
+
+    Socket ConnectTo(const std::string& endpoint) {
+        const std::string_view view = endpoint;
+        if(view.starts_with(UNIX_PREFIX)) {
+            const sockaddr_un address = MakeUnixAddress(view.substr(UNIX_PREFIX.size()));
+            Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+            if(!socket.IsOpen()) {
+                ThrowSystemError("can't create unix socket"s);
+            }
+            if(::connect(socket.GetFd(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+                ThrowSystemError("can't connect to "s + endpoint);
+            }
+            return socket;
+        }
+        if(view.starts_with(TCP_PREFIX)) {
+            Socket socket = OpenTcpSocket(view.substr(TCP_PREFIX.size()), false, [](const Socket& socket, const addrinfo& address) {
+                return ::connect(socket.GetFd(), address.ai_addr, address.ai_addrlen) == 0;
+            });
+            SetNoDelay(socket);
+            return socket;
+        }
+        throw std::invalid_argument("unknown endpoint "s + endpoint);
+    }
+
+    std::string GetLocalEndpoint(const Socket& listener) {
+        sockaddr_storage address = {};
+        socklen_t size = sizeof(address);
+        if(::getsockname(listener.GetFd(), reinterpret_cast<sockaddr*>(&address), &size) != 0) {
+            ThrowSystemError("can't get socket address"s);
+        }
+        char host[NI_MAXHOST];
+        char port[NI_MAXSERV];
+        switch(address.ss_family) {
+        case AF_UNIX:
+            return std::string(UNIX_PREFIX) + reinterpret_cast<const sockaddr_un&>(address).sun_path;
+        case AF_INET:
+        case AF_INET6:
+            if(int error = getnameinfo(reinterpret_cast<const sockaddr*>(&address), size, host, sizeof(host),
+                                       port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV); error != 0) {
+                throw std::runtime_error("can't get socket address: "s + gai_strerror(error));
+            }
+            return std::string(TCP_PREFIX) + host + ":"s + port;
+        default:
+            throw std::runtime_error("unknown socket address family");
+        }
+    }
+
+    void SendMessage(const Socket& socket, std::string_view payload) {
+        if(payload.size() > MAX_FRAME_SIZE) {
+            throw std::invalid_argument("shard message is too large");
+        }
+        // the size and the payload go out with one call, so small messages
+        // take a single packet even with Nagle's algorithm enabled
+        const uint32_t size = static_cast<uint32_t>(payload.size());
+        std::string frame(sizeof(size), '\0');
+        std::memcpy(frame.data(), &size, sizeof(size));
+        frame.append(payload);
+
+        size_t sent = 0;
+        while(sent < frame.size()) {
+            const ssize_t count = ::send(socket.GetFd(), frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+            if(count < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                ThrowSystemError("can't send to shard connection"s);
+            }
+            sent += static_cast<size_t>(count);
+        }
+    }
+
+    bool ReceiveMessage(const Socket& socket, std::string& payload) {
+        uint32_t size = 0;
+        if(!ReceiveBytes(socket, reinterpret_cast<char*>(&size), sizeof(size))) {
+            return false;
+        }
+        if(size > MAX_FRAME_SIZE) {
+            throw std::runtime_error("shard message is too large");
+        }
+        payload.resize(size);
+        if(size > 0 && !ReceiveBytes(socket, payload.data(), size)) {
+            throw std::runtime_error("shard connection closed in the middle of a message");
+        }
+        return true;
+    }
+
+    void WriteDocument(MessageWriter& writer, const SearchServer::Document& document) {
+        writer.WriteInt32(document.id_);
+        writer.WriteInt32(document.rating_);
+        writer.WriteDouble(document.relevance_);
+        writer.WriteUint8(static_cast<uint8_t>(document.status_));
+    }
+
+    SearchServer::Document ReadDocument(MessageReader& reader) {
+        SearchServer::Document document;
+        document.id_ = reader.ReadInt32();
+        document.rating_ = reader.ReadInt32();
+        document.relevance_ = reader.ReadDouble();
+        document.status_ = reader.ReadDocumentStatus();
+        return document;
+    }
+
+    std::string MakeErrorResponse(std::exception_ptr error) {
+        MessageWriter writer;
+        try {
+            std::rethrow_exception(error);
+        } catch(const std::invalid_argument& e) {
+            writer.WriteUint8(static_cast<uint8_t>(ResponseStatus::INVALID_ARGUMENT));
+            writer.WriteString(e.what());
+        } catch(const std::out_of_range& e) {
+            writer.WriteUint8(static_cast<uint8_t>(ResponseStatus::OUT_OF_RANGE));
+            writer.WriteString(e.what());
+        } catch(const std::exception& e) {
+            writer.WriteUint8(static_cast<uint8_t>(ResponseStatus::ERROR));
+            writer.WriteString(e.what());
+        } catch(...) {
+            writer.WriteUint8(static_cast<uint8_t>(ResponseStatus::ERROR));
+            writer.WriteString("unknown error");
+        }
+        return writer.GetPayload();
+    }
+
+    void CheckResponse(MessageReader& reader) {
+        const ResponseStatus status = static_cast<ResponseStatus>(reader.ReadUint8());
+        if(status == ResponseStatus::OK) {
+            return;
+        }
+        const std::string message(reader.ReadString());
+        switch(status) {
+        case ResponseStatus::INVALID_ARGUMENT:
+            throw std::invalid_argument(message);
+        case ResponseStatus::OUT_OF_RANGE:
+            throw std::out_of_range(message);
+        default:
+            throw std::runtime_error(message);
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <string_view>
+#include "search_server.h"
+
+// Binary protocol between a ShardCoordinator and its ShardNode processes.
+// Every message is a frame: a uint32 payload size followed by the payload.
+// A request payload starts with its RequestType, a response payload with
+// its ResponseStatus. Integers and doubles use the native byte order, so
+// both sides must run on machines with the same one. Strings are a uint32
+// size followed by the bytes.
+namespace shard_protocol {
+    enum class RequestType : uint8_t {
+        // int32 id, uint8 status, uint32 rating count, int32 ratings, string text
+        ADD_DOCUMENT = 1,
+        // int32 id
+        REMOVE_DOCUMENT = 2,
+        // uint32 word count, strings -> int32 document count, int32 document frequency of every word
+        GET_TERM_STATISTICS = 3,
+        // string query, uint8 status, int32 corpus document count, uint32 word count,
+        // (string word, int32 corpus document frequency) pairs -> uint32 document count,
+        // (int32 id, int32 rating, double relevance, uint8 status) documents
+        FIND_TOP_DOCUMENTS = 4,
+        // string query, int32 id -> uint32 word count, strings, uint8 status
+        MATCH_DOCUMENT = 5,
+        // stops the node once the response is sent
+        SHUTDOWN = 6,
+        // -> uint32 stop word count, strings
+        GET_STOP_WORDS = 7
+    };
+
+    // error responses carry the message of the exception as a string
+    enum class ResponseStatus : uint8_t {
+        OK = 0,
+        INVALID_ARGUMENT = 1,
+        OUT_OF_RANGE = 2,
+        ERROR = 3
+    };
+
+    // frames larger than this are rejected as corrupted
+    constexpr uint32_t MAX_FRAME_SIZE = 64u << 20;
+
+    // Appends fields to a payload.
+    class MessageWriter {
+    public:
+        void WriteUint8(uint8_t value);
+        void WriteInt32(int32_t value);
+        void WriteUint32(uint32_t value);
+        void WriteDouble(double value);
+        void WriteString(std::string_view value);
+
+        const std::string& GetPayload() const noexcept;
+
+    private:
+        std::string payload_;
+
+        void WriteBytes(const void* data, size_t size);
+    };
+
+    // Reads fields of a payload in order, std::runtime_error is thrown if
+    // the payload ends too early. The views point into the payload.
+    class MessageReader {
+    public:
+        explicit MessageReader(std::string_view payload);
+
+        uint8_t ReadUint8();
+        int32_t ReadInt32();
+        uint32_t ReadUint32();
+        double ReadDouble();
+        std::string_view ReadString();
+
+        // Reads the size of a list whose elements take at least
+        // min_element_size bytes each, so a corrupted size can't make the
+        // caller allocate more than the payload could hold.
+        uint32_t ReadCount(size_t min_element_size);
+
+        // std::invalid_argument for values that are no DocumentStatus
+        SearchServer::DocumentStatus ReadDocumentStatus();
+
+        bool IsEnd() const noexcept;
+
+    private:
+        std::string_view payload_;
+        size_t pos_ = 0;
+
+        void ReadBytes(void* data, size_t size);
+    };
+
+    // Owns a socket file descriptor.
+    class Socket {
+    public:
+        Socket() = default;
+        explicit Socket(int fd) noexcept;
+        Socket(const Socket&) = delete;
+        Socket& operator=(const Socket&) = delete;
+        Socket(Socket&& other) noexcept;
+        Socket& operator=(Socket&& other) noexcept;
+        ~Socket();
+
+        int GetFd() const noexcept;
+        bool IsOpen() const noexcept;
+        void Close() noexcept;
+
+    private:
+        int fd_ = -1;
+    };
+
+    // Endpoints are "unix:<path>" or "tcp:<host>:<port>". Listening on a unix
+    // path removes a stale socket file first, tcp port 0 picks a free port.
+    // Both throw std::invalid_argument for a malformed endpoint and
+    // std::runtime_error if the socket call fails.
+    Socket ListenOn(const std::string& endpoint);
+    Socket ConnectTo(const std::string& endpoint);
+
+    // the endpoint a listening socket is bound to, with the actual tcp port
+    std::string GetLocalEndpoint(const Socket& listener);
+
+    void SendMessage(const Socket& socket, std::string_view payload);
+
+    // Reads the payload of the next frame. Returns false if the peer closed
+    // the connection before a frame started, throws std::runtime_error if it
+    // closed it in the middle of one or the frame is too large.
+    bool ReceiveMessage(const Socket& socket, std::string& payload);
+
+    void WriteDocument(MessageWriter& writer, const SearchServer::Document& document);
+    SearchServer::Document ReadDocument(MessageReader& reader);
+
+    // response payload with the ResponseStatus and the message of error
+    std::string MakeErrorResponse(std::exception_ptr error);
+
+    // Reads the status of a response, rethrows an error response as the
+    // exception type it was made from.
+    void CheckResponse(MessageReader& reader);
+}
@@ -0,0 +1,128 @@
+#include "sharded_search_server.h"
+#include <exception>
+#include <stdexcept>
+
+ShardedSearchServer::ShardedSearchServer(const std::string& stop_words_text, size_t shard_count) {
+    if(shard_count == 0) {
+        throw std::invalid_argument("shard count must be positive!");
+    }
+    shards_.reserve(shard_count);
+    for(size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words_text);
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document,
+                                      SearchServer::DocumentStatus status, const std::vector<int>& ratings) {
+    if(document_id < 0) {
+        throw std::invalid_argument("document_id can't be less than 0!");
+    }
+    shards_[GetShardIndex(document_id)].AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::AddDocuments(std::span<const SearchServer::DocumentInput> documents) {
+    for(const SearchServer::DocumentInput& document : documents) {
+        if(document.id_ < 0) {
+            throw std::invalid_argument("document_id can't be less than 0!");
+        }
+    }
+    std::vector<std::vector<SearchServer::DocumentInput>> shard_documents(shards_.size());
+    for(const SearchServer::DocumentInput& document : documents) {
+        shard_documents[GetShardIndex(document.id_)].push_back(document);
+    }
+
+    // every shard adds all or none of its documents, so a failed batch is
+    // undone by removing the documents of the shards that succeeded
+    std::vector<std::exception_ptr> errors(shards_.size());
+    std::vector<size_t> indexes(shards_.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(),
+        [&](size_t i) {
+            try {
+                shards_[i].AddDocuments(shard_documents[i]);
+            } catch(...) {
+                errors[i] = std::current_exception();
+            }
+        });
+
+    auto error = std::find_if(errors.begin(), errors.end(), [](const std::exception_ptr& e) { return e != nullptr; });
+    if(error == errors.end()) {
+        return;
+    }
+    for(size_t i = 0; i < shards_.size(); ++i) {
+        if(errors[i] == nullptr && !shard_documents[i].empty()) {
+            std::vector<int> added_ids;
+            added_ids.reserve(shard_documents[i].size());
+            for(const SearchServer::DocumentInput& document : shard_documents[i]) {
+                added_ids.push_back(document.id_);
+            }
+            shards_[i].RemoveDocuments(added_ids);
+        }
+    }
+    std::rethrow_exception(*error);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    if(document_id < 0) {
+        return;
+    }
+    shards_[GetShardIndex(document_id)].RemoveDocument(document_id);
+}
+
+std::vector<SearchServer::Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status) const {
+    auto pred = [status](int id, SearchServer::DocumentStatus s, int r) {
+        return s == status;
+    };
+
+    return FindTopDocuments(raw_query, pred);
+}
+
+std::vector<SearchServer::Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, SearchServer::DocumentStatus::ACTUAL);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for(const SearchServer& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const noexcept {
+    return shards_.size();
+}
+
+int ShardedSearchServer::GetDocumentFrequency(std::string_view word) const {
+    int document_frequency = 0;
+    for(const SearchServer& shard : shards_) {
+        document_frequency += shard.GetDocumentFrequency(word);
+    }
+    return document_frequency;
+}
+
+std::tuple<std::vector<std::string>, SearchServer::DocumentStatus>
+ShardedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    if(document_id < 0) {
+        throw std::out_of_range("document doesn't exist!");
+    }
+    return shards_[GetShardIndex(document_id)].MatchDocument(raw_query, document_id);
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    return static_cast<size_t>(document_id) % shards_.size();
+}
+
+std::unordered_map<std::string_view, int> ShardedSearchServer::CountDocumentFrequencies(std::string_view raw_query) const {
+    // every shard has the same stop words
+    std::unordered_map<std::string_view, int> word_to_document_count;
+    auto is_stop_word = [this](std::string_view word) {
+        return shards_.front().GetStopWords().contains(word);
+    };
+    ForEachQueryWord(raw_query, is_stop_word, [this, &word_to_document_count](std::string_view word, bool) {
+        if(!word_to_document_count.contains(word)) {
+            word_to_document_count.emplace(word, GetDocumentFrequency(word));
+        }
+    });
+    return word_to_document_count;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "search_server.h"
+
+// Index split by document id into shard_count SearchServer shards, document
+// id goes to shard id % shard_count. A query is scored on every shard in
+// parallel and the top documents of the shards are merged. Idf is computed
+// from document frequencies summed over all shards, so relevance is the one
+// of a single SearchServer holding every document up to rounding: a shard
+// adds the words' contributions in the order it interned them, which may
+// change the last bits and so the order of documents with equal relevance.
+// Like SearchServer, queries may run concurrently with each other but not
+// with changes to the index.
+class ShardedSearchServer {
+public:
+    explicit ShardedSearchServer(const std::string& stop_words_text, size_t shard_count);
+
+    void AddDocument(int document_id, std::string_view document,
+                     SearchServer::DocumentStatus status, const std::vector<int>& ratings);
+
+    // Adds the documents of every shard in parallel. Either every document
+    // is added or, if any of them is invalid, none.
+    void AddDocuments(std::span<const SearchServer::DocumentInput> documents);
+
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate>
+    std::vector<SearchServer::Document> FindTopDocuments(
+            std::string_view raw_query, DocumentPredicate document_predicate) const {
+        // invalid queries throw here, before the parallel part
+        const std::unordered_map<std::string_view, int> word_to_document_count = CountDocumentFrequencies(raw_query);
+        const SearchServer::CorpusStatistics corpus_statistics = {
+            GetDocumentCount(),
+            [&word_to_document_count](std::string_view word) {
+                auto it = word_to_document_count.find(word);
+                return it == word_to_document_count.end() ? 0 : it->second;
+            }
+        };
+
+        std::vector<std::vector<SearchServer::Document>> shard_top_documents(shards_.size());
+        std::vector<size_t> indexes(shards_.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(std::execution::par, indexes.begin(), indexes.end(),
+            [&](size_t i) {
+                shard_top_documents[i] = shards_[i].FindTopDocuments(raw_query, document_predicate, corpus_statistics);
+            });
+
+        std::vector<SearchServer::Document> top_documents;
+        top_documents.reserve(MAX_RESULT_DOCUMENT_COUNT + 1);
+        for(const std::vector<SearchServer::Document>& shard_documents : shard_top_documents) {
+            for(const SearchServer::Document& document : shard_documents) {
+                SearchServer::PushTopDocument(top_documents, document, document.relevance_);
+            }
+        }
+        std::sort_heap(top_documents.begin(), top_documents.end(), SearchServer::IsMoreRelevant);
+        return top_documents;
+    }
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query, SearchServer::DocumentStatus status) const;
+
+    std::vector<SearchServer::Document> FindTopDocuments(std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+    size_t GetShardCount() const noexcept;
+
+    // number of documents of all shards containing the word
+    int GetDocumentFrequency(std::string_view word) const;
+
+    std::tuple<std::vector<std::string>, SearchServer::DocumentStatus>
+    MatchDocument(std::string_view raw_query, int document_id) const;
+
+private:
+    std::vector<SearchServer> shards_;
+
+    size_t GetShardIndex(int document_id) const;
+
+    // GetDocumentFrequency of every plus and minus word of the query, parsed
+    // with the stop words of the shards, the views point into raw_query
+    std::unordered_map<std::string_view, int> CountDocumentFrequencies(std::string_view raw_query) const;
+};
@@ -0,0 +1,67 @@
+#include "term_dictionary.h"
+#include <algorithm>
+#include <cstring>
+
+TermDictionary::TermDictionary(const TermDictionary& other) {
+    *this = other;
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if(this == &other) {
+        return *this;
+    }
+
+    arena_blocks_.clear();
+    current_block_size_ = 0;
+    current_block_used_ = 0;
+    term_to_id_.clear();
+    id_to_term_.clear();
+
+    term_to_id_.reserve(other.id_to_term_.size());
+    id_to_term_.reserve(other.id_to_term_.size());
+    for(std::string_view term : other.id_to_term_) {
+        Intern(term);
+    }
+    return *this;
+}
+
+TermId TermDictionary::Intern(std::string_view term) {
+    if(auto it = term_to_id_.find(term); it != term_to_id_.end()) {
+        return it->second;
+    }
+
+    TermId term_id = static_cast<TermId>(id_to_term_.size());
+    std::string_view stored_term = StoreInArena(term);
+    id_to_term_.push_back(stored_term);
+    term_to_id_.emplace(stored_term, term_id);
+    return term_id;
+}
+
+TermId TermDictionary::Find(std::string_view term) const {
+    if(auto it = term_to_id_.find(term); it != term_to_id_.end()) {
+        return it->second;
+    }
+    return NO_TERM;
+}
+
+std::string_view TermDictionary::GetTerm(TermId term_id) const {
+    return id_to_term_.at(term_id);
+}
+
+size_t TermDictionary::size() const noexcept {
+    return id_to_term_.size();
+}
+
+std::string_view TermDictionary::StoreInArena(std::string_view term) {
+    // words longer than a block get a block of their own
+    if(arena_blocks_.empty() || term.size() > current_block_size_ - current_block_used_) {
+        current_block_size_ = std::max(ARENA_BLOCK_SIZE, term.size());
+        arena_blocks_.push_back(std::make_unique_for_overwrite<char[]>(current_block_size_));
+        current_block_used_ = 0;
+    }
+
+    char* destination = arena_blocks_.back().get() + current_block_used_;
+    std::memcpy(destination, term.data(), term.size());
+    current_block_used_ += term.size();
+    return {destination, term.size()};
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using TermId = uint32_t;
+
+static constexpr TermId NO_TERM = std::numeric_limits<TermId>::max();
+
+// Maps every distinct word to a dense integer id. The characters of all
+// words are stored once in an append-only arena, so ids and the views
+// returned by GetTerm stay valid for the lifetime of the dictionary.
+class TermDictionary {
+public:
+    TermDictionary() = default;
+    TermDictionary(const TermDictionary& other);
+    TermDictionary(TermDictionary&& other) noexcept = default;
+    TermDictionary& operator=(const TermDictionary& other);
+    TermDictionary& operator=(TermDictionary&& other) noexcept = default;
+
+    TermId Intern(std::string_view term);
+    TermId Find(std::string_view term) const;
+    std::string_view GetTerm(TermId term_id) const;
+    size_t size() const noexcept;
+
+private:
+    static constexpr size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> arena_blocks_;
+    size_t current_block_size_ = 0;
+    size_t current_block_used_ = 0;
+    std::unordered_map<std::string_view, TermId> term_to_id_;
+    std::vector<std::string_view> id_to_term_;
+
+    std::string_view StoreInArena(std::string_view term);
+};
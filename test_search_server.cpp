@@ -5,6 +5,31 @@
 #include "testing_framework.h"
 #include "paginator.h"
 #include "request_queue.h"
+#include "index_snapshot.h"
+#include "segmented_search_server.h"
+#include "sharded_search_server.h"
+#include "shard_coordinator.h"
+#include "shard_node.h"
+#include "concurrent_search_server.h"
+#include "scoring_kernel.h"
+#include "query_executor.h"
+#include "process_queries.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <optional>
+#include <memory>
+#include <list>
+#include <sys/socket.h>
+#include <numeric>
+#include <set>
+
+using namespace std::string_view_literals;
 
 namespace {
     void TestDocumentAdding() {
@@ -35,6 +60,21 @@ namespace {
             ASSERT_EQUAL(server.GetDocumentCount(), 1);
             ASSERT_EQUAL(server.FindTopDocuments("").size(), 0);
         }
+
+        {
+            SearchServer server;
+            for(int id = 0; id < 10000; ++id) {
+                std::string text = id % 3 == 0 ? "rat not"s : id % 5 == 0 ? "rat very"s : "rat"s;
+                server.AddDocument(id, text, SearchServer::DocumentStatus::ACTUAL, {id % 7});
+            }
+            int found = 0;
+            for(const SearchServer::Document& document : server.FindTopDocuments("rat -not -very"s, 
+                    [](int, SearchServer::DocumentStatus, int) { return true; })) {
+                ASSERT(document.id_ % 3 != 0 && document.id_ % 5 != 0);
+                ++found;
+            }
+            ASSERT_EQUAL(found, 5);
+        }
     }
     
     void TestExcludeStopWordsFromAddedDocumentContent() {
@@ -188,6 +228,37 @@ namespace {
         }
     }
     
+    void TestTopDocumentsLimit() {
+        SearchServer server;
+        for(int id = 1; id <= 10; ++id) {
+            std::string content = "cat"s;
+            for(int i = 0; i < id; ++i) {
+                content += " tail"s;
+            }
+            server.AddDocument(id, content, SearchServer::DocumentStatus::ACTUAL, {id});
+        }
+        server.AddDocument(11, "dog"s, SearchServer::DocumentStatus::ACTUAL, {1});
+
+        {
+            std::vector<SearchServer::Document> results = server.FindTopDocuments("cat"s);
+            ASSERT_EQUAL(results.size(), MAX_RESULT_DOCUMENT_COUNT);
+            for(size_t i = 0; i < results.size(); ++i) {
+                ASSERT_EQUAL(results[i].id_, static_cast<int>(i) + 1);
+            }
+        }
+
+        {
+            std::vector<SearchServer::Document> results = 
+                server.FindTopDocuments("cat"s, [](int id, SearchServer::DocumentStatus s, int rating) {
+                    return id % 2 == 0;
+                });
+            ASSERT_EQUAL(results.size(), MAX_RESULT_DOCUMENT_COUNT);
+            for(size_t i = 0; i < results.size(); ++i) {
+                ASSERT_EQUAL(results[i].id_, 2 * (static_cast<int>(i) + 1));
+            }
+        }
+    }
+
     void TestStatusPredicate() {
         const int doc_id = 42;
         const std::string content = "cat in the city"s;
@@ -230,6 +301,1205 @@ namespace {
         ASSERT(documents[2].relevance_ - 0.173287 <= EPSILON * std::max(documents[0].relevance_, 0.173287));
     }
 
+    void TestSplitIntoWords() {
+        {
+            const std::string text = "  funny pet   and a very-very-long-nasty-rat-word  with curly hair "s;
+            std::vector<std::string_view> words = SplitIntoWords(text);
+            std::vector<std::string_view> expected = {
+                "funny"sv, "pet"sv, "and"sv, "a"sv, "very-very-long-nasty-rat-word"sv, "with"sv, "curly"sv, "hair"sv
+            };
+            ASSERT(words == expected);
+            ASSERT(SplitIntoWords(""s).empty());
+            ASSERT(SplitIntoWords("                                    "s).empty());
+        }
+
+        {
+            for(size_t pos : {0, 5, 15, 16, 17, 31, 40}) {
+                std::string text(41, 'a');
+                text[pos] = '\t';
+                bool thrown = false;
+                try {
+                    SplitIntoWords(text);
+                } catch(const std::invalid_argument&) {
+                    thrown = true;
+                }
+                ASSERT_HINT(thrown, "control character at "s + std::to_string(pos));
+            }
+        }
+
+        {
+            SearchServer server("in the"s);
+            bool thrown = false;
+            try {
+                server.AddDocument(1, "cat in the\ncity"s, SearchServer::DocumentStatus::ACTUAL, {1});
+            } catch(const std::invalid_argument&) {
+                thrown = true;
+            }
+            ASSERT(thrown);
+            ASSERT_EQUAL(server.GetDocumentCount(), 0);
+        }
+    }
+
+    void TestTermDictionary() {
+        TermDictionary dictionary;
+        TermId cat = dictionary.Intern("cat"s);
+        TermId dog = dictionary.Intern("dog"s);
+        ASSERT_EQUAL(cat, 0u);
+        ASSERT_EQUAL(dog, 1u);
+        ASSERT_EQUAL(dictionary.Intern("cat"s), cat);
+        ASSERT_EQUAL(dictionary.Find("dog"s), dog);
+        ASSERT_EQUAL(dictionary.Find("rat"s), NO_TERM);
+        ASSERT_EQUAL(dictionary.size(), 2);
+
+        const std::string long_word(100000, 'a');
+        TermId long_term = dictionary.Intern(long_word);
+        ASSERT_EQUAL(dictionary.GetTerm(long_term), long_word);
+
+        TermDictionary copy = dictionary;
+        dictionary = TermDictionary();
+        ASSERT_EQUAL(copy.GetTerm(cat), "cat"s);
+        ASSERT_EQUAL(copy.Find(long_word), long_term);
+    }
+
+    void TestWordFrequencies() {
+        SearchServer server("in the"s);
+        server.AddDocument(1, "cat in the city cat"s, SearchServer::DocumentStatus::BANNED, {1, 2, 3});
+
+        const std::map<std::string_view, double> word_freqs = server.GetWordFrequencies(1);
+        ASSERT_EQUAL(word_freqs.size(), 2);
+        ASSERT(std::abs(word_freqs.at("cat"s) - 2.0 / 3.0) < EPSILON);
+        ASSERT(std::abs(word_freqs.at("city"s) - 1.0 / 3.0) < EPSILON);
+        ASSERT(server.GetWordFrequencies(2).empty());
+
+        std::vector<SearchServer::Document> results = 
+            server.FindTopDocuments("cat"s, SearchServer::DocumentStatus::BANNED);
+        ASSERT_EQUAL(results.size(), 1);
+        ASSERT_EQUAL(results[0].id_, 1);
+        ASSERT_EQUAL(results[0].rating_, 2);
+        ASSERT(results[0].status_ == SearchServer::DocumentStatus::BANNED);
+    }
+
+    void TestDocumentsBatchAdding() {
+        const std::vector<std::string> texts = {
+            "funny pet and nasty rat"s,
+            "funny pet with curly hair"s,
+            "funny pet and not very nasty rat"s,
+            "pet with rat and rat and rat"s,
+            "nasty rat with curly hair"s,
+        };
+
+        {
+            SearchServer one_by_one("and with"s);
+            SearchServer batched("and with"s);
+            std::vector<SearchServer::DocumentInput> batch;
+            for(int id = 0; id < static_cast<int>(texts.size()); ++id) {
+                one_by_one.AddDocument(id, texts[id], SearchServer::DocumentStatus::ACTUAL, {id, 2});
+                batch.push_back({id, texts[id], SearchServer::DocumentStatus::ACTUAL, {id, 2}});
+            }
+            batched.AddDocuments(batch);
+
+            ASSERT_EQUAL(batched.GetDocumentCount(), one_by_one.GetDocumentCount());
+            for(const std::string& query : {"nasty rat -not"s, "not very funny nasty pet"s, "curly hair"s}) {
+                std::vector<SearchServer::Document> expected = one_by_one.FindTopDocuments(query);
+                std::vector<SearchServer::Document> actual = batched.FindTopDocuments(query);
+                ASSERT_EQUAL(actual.size(), expected.size());
+                for(size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUAL(actual[i].id_, expected[i].id_);
+                    ASSERT_EQUAL(actual[i].rating_, expected[i].rating_);
+                    ASSERT(std::abs(actual[i].relevance_ - expected[i].relevance_) < EPSILON);
+                }
+            }
+        }
+
+        {
+            SearchServer server;
+            server.AddDocument(1, "cat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+            const std::vector<std::vector<SearchServer::DocumentInput>> invalid_batches = {
+                {{2, "dog"sv, SearchServer::DocumentStatus::ACTUAL, {1}}, {1, "rat"sv, SearchServer::DocumentStatus::ACTUAL, {1}}},
+                {{2, "dog"sv, SearchServer::DocumentStatus::ACTUAL, {1}}, {2, "rat"sv, SearchServer::DocumentStatus::ACTUAL, {1}}},
+                {{2, "dog"sv, SearchServer::DocumentStatus::ACTUAL, {1}}, {-3, "rat"sv, SearchServer::DocumentStatus::ACTUAL, {1}}},
+                {{2, "dog"sv, SearchServer::DocumentStatus::ACTUAL, {1}}, {3, "r\x01t"sv, SearchServer::DocumentStatus::ACTUAL, {1}}},
+            };
+            for(const auto& batch : invalid_batches) {
+                bool thrown = false;
+                try {
+                    server.AddDocuments(batch);
+                } catch(const std::invalid_argument&) {
+                    thrown = true;
+                }
+                ASSERT(thrown);
+                ASSERT_EQUAL(server.GetDocumentCount(), 1);
+                ASSERT(server.FindTopDocuments("dog"s).empty());
+            }
+        }
+    }
+
+    void TestDocumentRemoving() {
+        {
+            SearchServer server;
+            server.AddDocument(1, "cat in the city"s, SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+            server.AddDocument(2, "dog in the city"s, SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+            server.RemoveDocument(1);
+            ASSERT_EQUAL(server.GetDocumentCount(), 1);
+            ASSERT(server.FindTopDocuments("cat"s).empty());
+            ASSERT_EQUAL(server.FindTopDocuments("city"s).size(), 1);
+            ASSERT_EQUAL(server.FindTopDocuments("city"s)[0].id_, 2);
+        }
+
+        {
+            SearchServer server;
+            server.AddDocument(1, "cat in the city"s, SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+            server.AddDocument(2, "dog in the city"s, SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+            server.RemoveDocument(2);
+            ASSERT(server.FindTopDocuments("city -dog"s).size() == 1);
+            server.RemoveDocument(1);
+            ASSERT(server.FindTopDocuments("city"s).empty());
+        }
+
+        {
+            SearchServer server;
+            SearchServer expected_server;
+            server.AddDocument(1, "cat in the city"s, SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+            server.AddDocument(2, "dog in the city"s, SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+            server.AddDocument(3, "dog and cat"s, SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+            expected_server.AddDocument(1, "cat in the city"s, SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+            expected_server.AddDocument(3, "dog and cat"s, SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+            server.RemoveDocument(2);
+
+            std::vector<SearchServer::Document> results = server.FindTopDocuments("city dog"s);
+            std::vector<SearchServer::Document> expected = expected_server.FindTopDocuments("city dog"s);
+            ASSERT_EQUAL(results.size(), 2);
+            ASSERT_EQUAL(results.size(), expected.size());
+            for(size_t i = 0; i < results.size(); ++i) {
+                ASSERT_EQUAL(results[i].id_, expected[i].id_);
+                ASSERT_EQUAL(results[i].relevance_, expected[i].relevance_);
+            }
+        }
+
+        {
+            // a removed document keeps its postings until most of a list is removed
+            SearchServer server;
+            for(int id = 0; id < 4; ++id) {
+                server.AddDocument(id, "cat in the city"s, SearchServer::DocumentStatus::ACTUAL, {id});
+            }
+            const size_t posting_count = server.GetIndexStatistics().posting_count_;
+            server.RemoveDocument(0);
+            ASSERT_EQUAL(server.GetIndexStatistics().posting_count_, posting_count);
+            ASSERT_EQUAL(server.GetDocumentFrequency("cat"s), 3);
+            ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 3u);
+            ASSERT_EQUAL(server.FindTopDocuments("cat"s, [](int id, SearchServer::DocumentStatus, int) { 
+                return id == 0; 
+            }).size(), 0u);
+            server.RemoveDocument(1);
+            server.RemoveDocument(2);
+            ASSERT(server.GetIndexStatistics().posting_count_ < posting_count);
+            ASSERT_EQUAL(server.GetDocumentFrequency("cat"s), 1);
+            ASSERT_EQUAL(server.FindTopDocuments("cat"s)[0].id_, 3);
+        }
+
+        {
+            // removing most documents renumbers the rest, ids and ratings must survive it
+            SearchServer server;
+            for(int id = 300; id > 0; --id) {
+                server.AddDocument(id, id % 2 == 0 ? "even cat"s : "odd dog"s, SearchServer::DocumentStatus::ACTUAL, {id});
+            }
+            std::vector<int> removed_ids;
+            for(int id = 1; id <= 290; ++id) {
+                removed_ids.push_back(id);
+            }
+            server.RemoveDocuments(removed_ids);
+            ASSERT_EQUAL(server.GetDocumentCount(), 10);
+
+            int expected_id = 291;
+            for(const auto& [document_id, document] : server) {
+                ASSERT_EQUAL(document_id, expected_id);
+                ASSERT_EQUAL(document.rating_, expected_id);
+                ++expected_id;
+            }
+            ASSERT_EQUAL(server.GetDocumentFrequency("cat"s), 5);
+            std::vector<SearchServer::Document> results = server.FindTopDocuments("cat"s);
+            ASSERT_EQUAL(results.size(), 5);
+            ASSERT_EQUAL(results[0].id_, 300);
+            ASSERT_EQUAL(results[0].rating_, 300);
+            ASSERT(std::get<0>(server.MatchDocument("dog"s, 291)) == std::vector<std::string>{"dog"s});
+        }
+    }
+
+    void TestDocumentFilter() {
+        SearchServer server;
+        server.AddDocument(1, "white cat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        server.AddDocument(2, "black cat"s, SearchServer::DocumentStatus::ACTUAL, {5});
+        server.AddDocument(3, "grey cat"s, SearchServer::DocumentStatus::BANNED, {9});
+        server.AddDocument(4, "fat cat"s, SearchServer::DocumentStatus::ACTUAL, {9});
+        server.AddDocument(5, "dog"s, SearchServer::DocumentStatus::ACTUAL, {9});
+
+        std::vector<SearchServer::Document> results = server.FindTopDocuments("cat"s, 
+            SearchServer::DocumentFilter{.min_rating_ = 2, .max_rating_ = 9});
+        ASSERT_EQUAL(results.size(), 2);
+        ASSERT_EQUAL(results[0].id_, 4);
+        ASSERT_EQUAL(results[1].id_, 2);
+
+        results = server.FindTopDocuments("cat"s, SearchServer::DocumentFilter{.status_ = SearchServer::DocumentStatus::BANNED});
+        ASSERT_EQUAL(results.size(), 1);
+        ASSERT_EQUAL(results[0].id_, 3);
+
+        // filtered documents still count for idf
+        std::vector<SearchServer::Document> expected = server.FindTopDocuments("cat"s, 
+            [](int document_id, SearchServer::DocumentStatus, int) { return document_id == 2; });
+        results = server.FindTopDocuments("cat"s, SearchServer::DocumentFilter{.min_rating_ = 5, .max_rating_ = 5});
+        ASSERT_EQUAL(results.size(), 1);
+        ASSERT_EQUAL(results[0].relevance_, expected[0].relevance_);
+
+        server.RemoveDocument(3);
+        ASSERT(server.FindTopDocuments("cat"s, SearchServer::DocumentStatus::BANNED).empty());
+    }
+
+    void TestTopDocumentsPruning() {
+        // pruned top documents against scoring every document by hand
+        std::mt19937 generator(42);
+        const std::vector<std::string> vocabulary = {"cat"s, "dog"s, "rat"s, "owl"s, "fox"s, "bee"s, "ant"s, "elk"s};
+        SearchServer server;
+        for(int id = 0; id < 2000; ++id) {
+            std::string text;
+            const int word_count = 1 + generator() % 6;
+            for(int i = 0; i < word_count; ++i) {
+                // skewed towards the first words, so common and rare terms meet
+                text += vocabulary[std::min(generator() % 8, generator() % 8)] + " "s;
+            }
+            const auto status = id % 10 == 0 ? SearchServer::DocumentStatus::BANNED : SearchServer::DocumentStatus::ACTUAL;
+            server.AddDocument(id, text, status, {static_cast<int>(generator() % 5)});
+        }
+
+        const std::vector<std::string> queries = {"cat"s, "cat dog"s, "cat dog rat owl"s, "elk ant bee fox owl rat dog cat"s, 
+                                                  "cat dog -rat"s, "ant bee -cat -dog"s, "cat -cat"s};
+        for(const std::string& query : queries) {
+            std::vector<std::string_view> plus_words;
+            std::vector<std::string_view> minus_words;
+            for(std::string_view word : SplitIntoWords(query)) {
+                if(word[0] == '-') {
+                    minus_words.push_back(word.substr(1));
+                } else {
+                    plus_words.push_back(word);
+                }
+            }
+
+            std::vector<SearchServer::Document> expected;
+            for(const auto& [document_id, document] : server) {
+                if(document.status_ != SearchServer::DocumentStatus::ACTUAL) {
+                    continue;
+                }
+                const std::map<std::string_view, double> word_freqs = server.GetWordFrequencies(document_id);
+                bool is_excluded = std::any_of(minus_words.begin(), minus_words.end(), [&word_freqs](std::string_view word) {
+                    return word_freqs.contains(word);
+                });
+                SearchServer::Document scored = document;
+                bool is_matched = false;
+                for(std::string_view word : plus_words) {
+                    if(auto it = word_freqs.find(word); it != word_freqs.end()) {
+                        scored.relevance_ += it->second * SearchServer::ComputeIdf(server.GetDocumentCount(), server.GetDocumentFrequency(word));
+                        is_matched = true;
+                    }
+                }
+                if(is_matched && !is_excluded) {
+                    expected.push_back(scored);
+                }
+            }
+            std::stable_sort(expected.begin(), expected.end(), SearchServer::IsMoreRelevant);
+            expected.resize(std::min(expected.size(), MAX_RESULT_DOCUMENT_COUNT));
+
+            const std::vector<SearchServer::Document> results = server.FindTopDocuments(query);
+            ASSERT_EQUAL(results.size(), expected.size());
+            for(size_t i = 0; i < results.size(); ++i) {
+                ASSERT(std::abs(results[i].relevance_ - expected[i].relevance_) < 1e-9);
+                ASSERT_EQUAL(results[i].rating_, expected[i].rating_);
+            }
+        }
+    }
+
+    void TestSearchPages() {
+        std::mt19937 generator(7);
+        const std::vector<std::string> vocabulary = {"cat"s, "dog"s, "rat"s, "owl"s, "fox"s};
+        SearchServer server;
+        int expected_count = 0;
+        for(int id = 0; id < 1000; ++id) {
+            std::string text;
+            const int word_count = 1 + generator() % 4;
+            for(int i = 0; i < word_count; ++i) {
+                text += vocabulary[generator() % vocabulary.size()] + " "s;
+            }
+            if(text.find("cat"s) != std::string::npos || text.find("dog"s) != std::string::npos) {
+                ++expected_count;
+            }
+            // few ratings, so equal relevance and rating fall back to the id
+            server.AddDocument(id, text, SearchServer::DocumentStatus::ACTUAL, {static_cast<int>(generator() % 3)});
+        }
+
+        const SearchServer::DocumentFilter filter;
+        const std::vector<SearchServer::Document> all = server.FindTopDocuments("cat dog"s, filter, 5000, 0);
+        ASSERT_EQUAL(all.size(), expected_count);
+        ASSERT(std::is_sorted(all.begin(), all.end(), SearchServer::IsBeforeInPages));
+        for(size_t i = 1; i < all.size(); ++i) {
+            ASSERT(SearchServer::IsBeforeInPages(all[i - 1], all[i]));
+        }
+        const std::vector<SearchServer::Document> first_page = server.FindTopDocuments("cat dog"s, filter, 5, 0);
+        const std::vector<SearchServer::Document> top = server.FindTopDocuments("cat dog"s);
+        ASSERT_EQUAL(first_page.size(), top.size());
+        for(size_t i = 0; i < top.size(); ++i) {
+            ASSERT(std::abs(first_page[i].relevance_ - top[i].relevance_) < 1e-9);
+        }
+
+        // offset pages and cursor pages both walk the same order, term-at-a-time and with MaxScore
+        for(const std::string& query : {"cat dog"s, "cat dog rat -owl"s}) {
+            const std::vector<SearchServer::Document> expected = server.FindTopDocuments(query, filter, 5000, 0);
+            const size_t page_size = 20;
+            std::vector<SearchServer::Document> by_cursor;
+            std::optional<SearchServer::SearchCursor> after;
+            for(size_t offset = 0;; offset += page_size) {
+                const std::vector<SearchServer::Document> page = server.FindTopDocuments(query, filter, page_size, offset);
+                const std::vector<SearchServer::Document> next = after
+                    ? server.FindTopDocuments(query, filter, page_size, 
+                          SearchServer::SearchCursor::FromString(after->ToString()))
+                    : server.FindTopDocuments(query, filter, page_size, 0);
+                ASSERT_EQUAL(page.size(), std::min(page_size, expected.size() - std::min(offset, expected.size())));
+                ASSERT_EQUAL(next.size(), page.size());
+                for(size_t i = 0; i < page.size(); ++i) {
+                    ASSERT_EQUAL(page[i].id_, expected[offset + i].id_);
+                    ASSERT_EQUAL(next[i].id_, page[i].id_);
+                }
+                if(next.empty()) {
+                    break;
+                }
+                by_cursor.insert(by_cursor.end(), next.begin(), next.end());
+                after = SearchServer::SearchCursor::After(next.back());
+            }
+            ASSERT_EQUAL(by_cursor.size(), expected.size());
+        }
+        ASSERT(server.FindTopDocuments("cat dog"s, filter, 0, 0).empty());
+        ASSERT(server.FindTopDocuments("cat dog"s, filter, 10, 5000).empty());
+
+        const SearchServer::SearchCursor cursor = SearchServer::SearchCursor::After(all[3]);
+        const SearchServer::SearchCursor parsed = SearchServer::SearchCursor::FromString(cursor.ToString());
+        ASSERT_EQUAL(parsed.relevance_, cursor.relevance_);
+        ASSERT_EQUAL(parsed.rating_, cursor.rating_);
+        ASSERT_EQUAL(parsed.id_, cursor.id_);
+        for(const std::string& text : {""s, "abc"s, "1:2"s, "1:2:3:"s, "1:2:x"s, "zz:1:1"s}) {
+            bool is_thrown = false;
+            try {
+                SearchServer::SearchCursor::FromString(text);
+            } catch(const std::invalid_argument&) {
+                is_thrown = true;
+            }
+            ASSERT(is_thrown);
+        }
+    }
+
+    void TestQueryBatch() {
+        std::mt19937 generator(11);
+        const std::vector<std::string> vocabulary = {"cat"s, "dog"s, "rat"s, "owl"s, "fox"s, "bee"s, "ant"s, "elk"s};
+        SearchServer server("and with"s);
+        for(int id = 0; id < 3000; ++id) {
+            std::string text;
+            const int word_count = 1 + generator() % 5;
+            for(int i = 0; i < word_count; ++i) {
+                text += vocabulary[std::min(generator() % 8, generator() % 8)] + " "s;
+            }
+            const auto status = id % 7 == 0 ? SearchServer::DocumentStatus::BANNED : SearchServer::DocumentStatus::ACTUAL;
+            server.AddDocument(id, text, status, {static_cast<int>(generator() % 4)});
+        }
+
+        // duplicates, reordered duplicates, shared words, both scoring paths
+        const std::vector<std::string> queries = {"cat"s, "cat dog"s, "dog cat"s, "cat"s, "cat -dog"s, "dog -cat"s, 
+                                                  "cat dog rat owl"s, "owl rat dog cat"s, "elk ant bee"s, "elk"s, 
+                                                  "unknown"s, "and"s, "cat -cat"s, "fox bee -elk"s, "cat dog"s};
+        const std::vector<std::vector<SearchServer::Document>> results = server.FindTopDocumentsBatch(queries);
+        ASSERT_EQUAL(results.size(), queries.size());
+        for(size_t i = 0; i < queries.size(); ++i) {
+            const std::vector<SearchServer::Document> expected = server.FindTopDocuments(queries[i]);
+            ASSERT_EQUAL(results[i].size(), expected.size());
+            for(size_t j = 0; j < expected.size(); ++j) {
+                ASSERT_EQUAL(results[i][j].id_, expected[j].id_);
+                ASSERT_EQUAL(results[i][j].relevance_, expected[j].relevance_);
+                ASSERT_EQUAL(results[i][j].rating_, expected[j].rating_);
+            }
+        }
+        ASSERT(server.FindTopDocumentsBatch(std::vector<std::string>{}).empty());
+    }
+
+    void TestScoringKernels() {
+        const ScoringKernel default_kernel = GetScoringKernel();
+        SearchServer server;
+        for(int id = 0; id < 3000; ++id) {
+            std::string text = "cat"s;
+            for(int word = 0; word < id % 7; ++word) {
+                text += id % (word + 2) == 0 ? " dog"s : " rat"s;
+            }
+            server.AddDocument(id, text, id % 4 == 0 ? SearchServer::DocumentStatus::BANNED : SearchServer::DocumentStatus::ACTUAL, 
+                               {id % 11});
+        }
+
+        const std::vector<std::string> queries = {"dog"s, "cat dog"s, "rat -dog"s, "dog rat cat"s};
+        std::vector<std::vector<SearchServer::Document>> expected;
+        SetScoringKernel(ScoringKernel::SCALAR);
+        for(const std::string& query : queries) {
+            expected.push_back(server.FindTopDocuments(query));
+        }
+
+        for(ScoringKernel kernel : {ScoringKernel::SSE2, ScoringKernel::AVX2}) {
+            if(!IsScoringKernelSupported(kernel)) {
+                continue;
+            }
+            SetScoringKernel(kernel);
+            for(size_t i = 0; i < queries.size(); ++i) {
+                const std::vector<SearchServer::Document> results = server.FindTopDocuments(queries[i]);
+                ASSERT_EQUAL(results.size(), expected[i].size());
+                for(size_t j = 0; j < results.size(); ++j) {
+                    ASSERT_EQUAL(results[j].id_, expected[i][j].id_);
+                    ASSERT_EQUAL(results[j].relevance_, expected[i][j].relevance_);
+                }
+            }
+
+            std::vector<double> scores(40, 0.0);
+            std::vector<uint8_t> matched(40, 0);
+            const std::vector<uint32_t> ordinals = {1, 3, 4, 8, 9, 20, 33, 39};
+            const std::vector<double> tfs = {0.5, 1.0, 0.25, 2.0, 0.5, 1.0, 3.0, 0.1};
+            AccumulateScores(ordinals.data(), tfs.data(), ordinals.size(), 2.0, scores.data(), matched.data());
+            AccumulateScores(ordinals.data(), tfs.data(), 3, 2.0, scores.data(), matched.data());
+            ASSERT_EQUAL(scores[3], 4.0);
+            ASSERT_EQUAL(scores[8], 4.0);
+            ASSERT_EQUAL(scores[5], 0.0);
+
+            std::vector<uint32_t> selected(40);
+            selected.resize(SelectCandidates(scores.data(), matched.data(), 2, 40, 1.0, selected.data()));
+            ASSERT((selected == std::vector<uint32_t>{3, 4, 8, 9, 20, 33}));
+        }
+        SetScoringKernel(default_kernel);
+    }
+
+    void TestDocumentBitmap() {
+        DocumentBitmap bitmap;
+        for(uint32_t value = 0; value < 10000; value += 2) {
+            bitmap.Add(value);
+        }
+        bitmap.Add(70000);
+        bitmap.Add(70000);
+        ASSERT_EQUAL(bitmap.Cardinality(), 5001u);
+        ASSERT(bitmap.Contains(9998));
+        ASSERT(!bitmap.Contains(9999));
+        ASSERT(bitmap.Contains(70000));
+        ASSERT(!bitmap.Contains(1u << 30));
+
+        // shrinking a dense container back to an array keeps its values
+        for(uint32_t value = 0; value < 9000; value += 2) {
+            bitmap.Remove(value);
+        }
+        bitmap.Remove(1);
+        ASSERT_EQUAL(bitmap.Cardinality(), 501u);
+        ASSERT(!bitmap.Contains(8998));
+        ASSERT(bitmap.Contains(9000));
+        ASSERT(bitmap.Contains(9998));
+        ASSERT(bitmap.Contains(70000));
+
+        bitmap.Clear();
+        ASSERT_EQUAL(bitmap.Cardinality(), 0u);
+        ASSERT(!bitmap.Contains(70000));
+    }
+
+    void TestPostingList() {
+        PostingList postings;
+        ASSERT(postings.empty());
+        for(uint32_t ordinal = 0; ordinal < 1000; ++ordinal) {
+            postings.Append(ordinal * 3, ordinal % 7 + 1, (ordinal % 7 + 1) / 10.0);
+        }
+        postings.Append(1000000, 200, 0.5);
+        ASSERT_EQUAL(postings.size(), 1001u);
+        ASSERT_EQUAL(postings.GetFirstOrdinal(), 0u);
+        ASSERT_EQUAL(postings.GetLastOrdinal(), 1000000u);
+        ASSERT_EQUAL(postings.GetMaxTf(), 0.7);
+        ASSERT_EQUAL(postings.GetBlockCount(), 8u);
+        ASSERT_EQUAL(postings.GetBlock(7).max_tf_, 0.7);
+        // small gaps and counts take a byte each
+        ASSERT(postings.GetMemoryUsage() < 1001 * 4);
+
+        std::vector<uint32_t> ordinals(PostingList::BLOCK_SIZE);
+        std::vector<uint32_t> counts(PostingList::BLOCK_SIZE);
+        ASSERT_EQUAL(postings.DecodeBlock(7, ordinals.data(), counts.data()), 105u);
+        ASSERT_EQUAL(ordinals[0], 896u * 3);
+        ASSERT_EQUAL(ordinals[104], 1000000u);
+        ASSERT_EQUAL(counts[104], 200u);
+
+        PostingCursor cursor(postings);
+        size_t posting_count = 0;
+        for(; !cursor.IsEnd(); cursor.Next()) {
+            ++posting_count;
+        }
+        ASSERT_EQUAL(posting_count, 1001u);
+
+        PostingCursor seeking(postings);
+        seeking.SeekTo(301);
+        ASSERT_EQUAL(seeking.GetOrdinal(), 303u);
+        ASSERT_EQUAL(seeking.GetCount(), 101u % 7 + 1);
+        seeking.SeekTo(10);
+        ASSERT_EQUAL(seeking.GetOrdinal(), 303u);
+        // a shallow seek only moves between blocks
+        seeking.ShallowSeekTo(2999);
+        ASSERT_EQUAL(seeking.GetBlockMaxTf(), 0.7);
+        seeking.SeekTo(2999);
+        ASSERT_EQUAL(seeking.GetOrdinal(), 1000000u);
+        seeking.Next();
+        ASSERT(seeking.IsEnd());
+    }
+
+    void TestDuplicatesRemoving() {
+        SearchServer server("and with"s);
+        server.AddDocument(5, "funny pet and nasty rat"s, SearchServer::DocumentStatus::ACTUAL, {1, 2});
+        server.AddDocument(2, "funny pet with curly hair"s, SearchServer::DocumentStatus::ACTUAL, {1, 2});
+        server.AddDocument(3, "funny pet with curly hair"s, SearchServer::DocumentStatus::ACTUAL, {1, 2});
+        server.AddDocument(4, "nasty rat funny pet"s, SearchServer::DocumentStatus::ACTUAL, {1, 2});
+        server.AddDocument(1, "rat rat nasty funny pet pet"s, SearchServer::DocumentStatus::BANNED, {1, 2});
+        server.AddDocument(6, "nasty rat with curly hair"s, SearchServer::DocumentStatus::ACTUAL, {1, 2});
+        server.AddDocument(7, "curly"s, SearchServer::DocumentStatus::ACTUAL, {1, 2});
+
+        RemoveDuplicates(server);
+        std::vector<int> ids;
+        for(const auto& [document_id, _] : server) {
+            ids.push_back(document_id);
+        }
+        ASSERT((ids == std::vector<int>{1, 2, 6, 7}));
+        ASSERT_EQUAL(server.GetDocumentCount(), 4);
+        ASSERT_EQUAL(server.GetDocumentFrequency("hair"s), 2);
+        ASSERT_EQUAL(server.GetDocumentFrequency("pet"s), 2);
+
+        server.RemoveDocuments(std::vector<int>{2, 42, 6});
+        ASSERT_EQUAL(server.GetDocumentCount(), 2);
+        ASSERT_EQUAL(server.GetDocumentFrequency("hair"s), 0);
+        ASSERT(server.FindTopDocuments("curly"s).size() == 1);
+    }
+
+    void TestIndexSnapshot() {
+        SearchServer server("and with"s);
+        server.AddDocument(1, "funny pet and nasty rat"s, SearchServer::DocumentStatus::ACTUAL, {7, 2, 7});
+        server.AddDocument(2, "funny pet with curly hair"s, SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+        server.AddDocument(3, "funny pet and not very nasty rat"s, SearchServer::DocumentStatus::BANNED, {1, 2, 8});
+        server.AddDocument(4, "pet with rat and rat and rat"s, SearchServer::DocumentStatus::ACTUAL, {1, 3, 2});
+        server.AddDocument(5, "nasty rat with curly hair"s, SearchServer::DocumentStatus::ACTUAL, {1, 1, 1});
+        server.AddDocument(6, "hamster"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        server.RemoveDocument(6);
+
+        const std::string path = (std::filesystem::temp_directory_path() / "search_server_test.idx").string();
+        IndexSnapshot::Save(server, path);
+        const IndexSnapshot snapshot(path);
+        snapshot.Verify();
+
+        ASSERT_EQUAL(snapshot.GetDocumentCount(), server.GetDocumentCount());
+        for(const std::string& query : {"nasty rat -not"s, "not very funny nasty pet"s, "curly hair"s, "hamster"s, "and"s}) {
+            for(auto status : {SearchServer::DocumentStatus::ACTUAL, SearchServer::DocumentStatus::BANNED}) {
+                std::vector<SearchServer::Document> expected = server.FindTopDocuments(query, status);
+                std::vector<SearchServer::Document> actual = snapshot.FindTopDocuments(query, status);
+                ASSERT_EQUAL(actual.size(), expected.size());
+                for(size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUAL(actual[i].id_, expected[i].id_);
+                    ASSERT_EQUAL(actual[i].rating_, expected[i].rating_);
+                    ASSERT(actual[i].status_ == expected[i].status_);
+                    ASSERT_EQUAL(actual[i].relevance_, expected[i].relevance_);
+                }
+            }
+            for(int id = 1; id <= 5; ++id) {
+                ASSERT(snapshot.MatchDocument(query, id) == server.MatchDocument(query, id));
+            }
+        }
+        for(int id = 1; id <= 6; ++id) {
+            ASSERT(snapshot.GetWordFrequencies(id) == server.GetWordFrequencies(id));
+        }
+
+        {
+            // a posting pointing past the documents section, at the offset
+            // the header stores for the postings section
+            std::string bytes;
+            {
+                std::ifstream in(path, std::ios::binary);
+                bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+            const size_t postings_offset_field = 8 + 4 + 4 + 6 * 8 + 3 * 8;
+            uint64_t postings_offset = 0;
+            std::memcpy(&postings_offset, bytes.data() + postings_offset_field, sizeof(postings_offset));
+            const uint32_t bad_document_index = 1000;
+            std::memcpy(bytes.data() + postings_offset, &bad_document_index, sizeof(bad_document_index));
+            std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+            // postings are only checked when read, "curly" owns the first one
+            const IndexSnapshot broken(path);
+            ASSERT_EQUAL(broken.FindTopDocuments("hair"s).size(), 2u);
+            auto throws_runtime_error = [](auto action) {
+                try {
+                    action();
+                } catch(const std::runtime_error&) {
+                    return true;
+                }
+                return false;
+            };
+            ASSERT(throws_runtime_error([&broken] { broken.FindTopDocuments("curly"s); }));
+            ASSERT(throws_runtime_error([&broken] { broken.Verify(); }));
+        }
+        {
+            std::ofstream(path, std::ios::binary | std::ios::trunc) << "not an index"s;
+            bool thrown = false;
+            try {
+                IndexSnapshot broken(path);
+            } catch(const std::runtime_error&) {
+                thrown = true;
+            }
+            ASSERT(thrown);
+        }
+        {
+            // renaming over a non-empty directory fails after the file is written
+            std::filesystem::remove(path);
+            std::filesystem::create_directory(path);
+            std::ofstream(path + "/keep"s) << "keep"s;
+            bool thrown = false;
+            try {
+                IndexSnapshot::Save(server, path);
+            } catch(const std::exception&) {
+                thrown = true;
+            }
+            ASSERT(thrown);
+            ASSERT(!std::filesystem::exists(path + ".tmp"s));
+            std::filesystem::remove_all(path);
+        }
+        std::filesystem::remove(path);
+    }
+
+    void TestSegmentedSearchServer() {
+        const std::vector<std::string> texts = {
+            "funny pet and nasty rat"s,
+            "funny pet with curly hair"s,
+            "funny pet and not very nasty rat"s,
+            "pet with rat and rat and rat"s,
+            "nasty rat with curly hair"s,
+            "big cat nasty hair"s,
+            "big dog cat Vladislav"s,
+            "big dog hamster Borya"s,
+            "curly cat curly tail"s,
+        };
+        const std::vector<std::string> queries = {
+            "nasty rat -not"s, "not very funny nasty pet"s, "curly hair"s, "big cat -dog"s, "hamster"s
+        };
+
+        SearchServer expected_server("and with"s);
+        SegmentedSearchServer server("and with"s, 2, 3);
+        auto check_results = [&]() {
+            ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+            for(const std::string& query : queries) {
+                std::vector<SearchServer::Document> expected = expected_server.FindTopDocuments(query);
+                std::vector<SearchServer::Document> actual = server.FindTopDocuments(query);
+                ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+                for(size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUAL_HINT(actual[i].id_, expected[i].id_, query);
+                    ASSERT(std::abs(actual[i].relevance_ - expected[i].relevance_) < EPSILON);
+                }
+            }
+        };
+
+        for(int id = 0; id < static_cast<int>(texts.size()); ++id) {
+            expected_server.AddDocument(id, texts[id], SearchServer::DocumentStatus::ACTUAL, {id});
+            server.AddDocument(id, texts[id], SearchServer::DocumentStatus::ACTUAL, {id});
+        }
+        check_results();
+
+        for(int id : {0, 5, 8}) {
+            expected_server.RemoveDocument(id);
+            server.RemoveDocument(id);
+        }
+        check_results();
+        ASSERT(std::get<0>(server.MatchDocument("curly hair"s, 4)) == std::get<0>(expected_server.MatchDocument("curly hair"s, 4)));
+
+        expected_server.AddDocument(5, "nasty nasty hamster"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        server.AddDocument(5, "nasty nasty hamster"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        server.MergeSegments();
+        check_results();
+        ASSERT(server.GetSegmentCount() <= 2);
+
+        bool thrown = false;
+        try {
+            server.AddDocument(4, "cat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        } catch(const std::invalid_argument&) {
+            thrown = true;
+        }
+        ASSERT(thrown);
+
+        // 32 one-document segments merge tier by tier into a single one
+        SegmentedSearchServer tiered_server("and with"s, 1, 2);
+        for(int id = 0; id < 32; ++id) {
+            tiered_server.AddDocument(id, texts[id % texts.size()], SearchServer::DocumentStatus::ACTUAL, {id});
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while(tiered_server.GetSegmentCount() > 2 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_EQUAL(tiered_server.GetSegmentCount(), 2u);
+        ASSERT_EQUAL(tiered_server.GetDocumentCount(), 32);
+    }
+
+    void TestShardedSearchServer() {
+        const std::vector<std::string> texts = {
+            "funny pet and nasty rat"s,
+            "funny pet with curly hair"s,
+            "funny pet and not very nasty rat"s,
+            "pet with rat and rat and rat"s,
+            "nasty rat with curly hair"s,
+            "big cat nasty hair"s,
+            "big dog cat Vladislav"s,
+            "big dog hamster Borya"s,
+            "curly cat curly tail"s,
+        };
+        const std::vector<std::string> queries = {
+            "nasty rat -not"s, "not very funny nasty pet"s, "curly hair"s, "big cat -dog"s, "hamster"s, "and"s,
+            // a stop word covers the token that would be an invalid minus word
+            "big cat -"s
+        };
+
+        SearchServer expected_server("and with -"s);
+        ShardedSearchServer server("and with -"s, 3);
+        ASSERT_EQUAL(server.GetShardCount(), 3u);
+        auto check_results = [&]() {
+            ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+            for(const std::string& query : queries) {
+                std::vector<SearchServer::Document> expected = expected_server.FindTopDocuments(query);
+                std::vector<SearchServer::Document> actual = server.FindTopDocuments(query);
+                ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+                for(size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUAL_HINT(actual[i].id_, expected[i].id_, query);
+                    ASSERT_EQUAL_HINT(actual[i].relevance_, expected[i].relevance_, query);
+                }
+            }
+        };
+
+        std::vector<SearchServer::DocumentInput> documents;
+        for(int id = 0; id < static_cast<int>(texts.size()); ++id) {
+            expected_server.AddDocument(id, texts[id], SearchServer::DocumentStatus::ACTUAL, {id});
+            documents.push_back({id, texts[id], SearchServer::DocumentStatus::ACTUAL, {id}});
+        }
+        server.AddDocuments(documents);
+        check_results();
+        ASSERT_EQUAL(server.GetDocumentFrequency("nasty"s), expected_server.GetDocumentFrequency("nasty"s));
+
+        for(int id : {0, 5, 8}) {
+            expected_server.RemoveDocument(id);
+            server.RemoveDocument(id);
+        }
+        check_results();
+        ASSERT(std::get<0>(server.MatchDocument("curly hair"s, 4)) == std::get<0>(expected_server.MatchDocument("curly hair"s, 4)));
+
+        // the invalid document of one shard keeps the others from being added
+        const std::vector<SearchServer::DocumentInput> invalid_documents = {
+            {10, "nasty hamster"sv, SearchServer::DocumentStatus::ACTUAL, {1}},
+            {11, "curly \x01 rat"sv, SearchServer::DocumentStatus::ACTUAL, {1}},
+        };
+        bool thrown = false;
+        try {
+            server.AddDocuments(invalid_documents);
+        } catch(const std::invalid_argument&) {
+            thrown = true;
+        }
+        ASSERT(thrown);
+        check_results();
+
+        expected_server.AddDocument(5, "nasty nasty hamster"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        server.AddDocument(5, "nasty nasty hamster"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        check_results();
+
+        thrown = false;
+        try {
+            server.AddDocument(4, "cat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        } catch(const std::invalid_argument&) {
+            thrown = true;
+        }
+        ASSERT(thrown);
+    }
+
+    void TestShardCluster() {
+        const std::vector<std::string> texts = {
+            "funny pet and nasty rat"s,
+            "funny pet with curly hair"s,
+            "funny pet and not very nasty rat"s,
+            "pet with rat and rat and rat"s,
+            "nasty rat with curly hair"s,
+            "big cat nasty hair"s,
+            "big dog cat Vladislav"s,
+            "big dog hamster Borya"s,
+            "curly cat curly tail"s,
+        };
+        const std::vector<std::string> queries = {
+            "nasty rat -not"s, "not very funny nasty pet"s, "curly hair"s, "big cat -dog"s, "hamster"s, "and"s,
+            // a stop word covers the token that would be an invalid minus word
+            "big cat -"s
+        };
+
+        // the nodes run on threads of this process, but talk over real sockets
+        std::vector<std::unique_ptr<ShardNode>> nodes;
+        for(int i = 0; i < 2; ++i) {
+            const std::string path = (std::filesystem::temp_directory_path() / 
+                ("search_server_test_shard_"s + std::to_string(i) + ".sock"s)).string();
+            nodes.push_back(std::make_unique<ShardNode>(SearchServer("and with -"s), "unix:"s + path));
+        }
+        nodes.push_back(std::make_unique<ShardNode>(SearchServer("and with -"s), "tcp:127.0.0.1:0"s));
+        std::vector<std::string> endpoints;
+        std::vector<std::thread> node_threads;
+        for(const std::unique_ptr<ShardNode>& node : nodes) {
+            endpoints.push_back(node->GetEndpoint());
+            node_threads.emplace_back([&node] { node->Serve(); });
+        }
+        ASSERT(endpoints.back() != "tcp:127.0.0.1:0"s);
+
+        SearchServer expected_server("and with -"s);
+        ShardCoordinator coordinator(endpoints);
+        ASSERT_EQUAL(coordinator.GetShardCount(), 3u);
+        auto check_results = [&]() {
+            ASSERT_EQUAL(coordinator.GetDocumentCount(), expected_server.GetDocumentCount());
+            for(const std::string& query : queries) {
+                std::vector<SearchServer::Document> expected = expected_server.FindTopDocuments(query);
+                std::vector<SearchServer::Document> actual = coordinator.FindTopDocuments(query);
+                ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+                for(size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUAL_HINT(actual[i].id_, expected[i].id_, query);
+                    ASSERT_EQUAL_HINT(actual[i].rating_, expected[i].rating_, query);
+                    ASSERT_EQUAL_HINT(actual[i].relevance_, expected[i].relevance_, query);
+                }
+            }
+        };
+
+        for(int id = 0; id < static_cast<int>(texts.size()); ++id) {
+            expected_server.AddDocument(id, texts[id], SearchServer::DocumentStatus::ACTUAL, {id});
+            coordinator.AddDocument(id, texts[id], SearchServer::DocumentStatus::ACTUAL, {id});
+        }
+        expected_server.AddDocument(9, "nasty cat"s, SearchServer::DocumentStatus::BANNED, {1});
+        coordinator.AddDocument(9, "nasty cat"s, SearchServer::DocumentStatus::BANNED, {1});
+        check_results();
+        ASSERT_EQUAL(coordinator.FindTopDocuments("nasty cat"s, SearchServer::DocumentStatus::BANNED).size(), 1u);
+
+        for(int id : {0, 5, 8}) {
+            expected_server.RemoveDocument(id);
+            coordinator.RemoveDocument(id);
+        }
+        check_results();
+        ASSERT(coordinator.MatchDocument("curly hair"s, 4) == expected_server.MatchDocument("curly hair"s, 4));
+
+        // errors of a node come back as the exceptions SearchServer throws
+        auto throws_invalid_argument = [](auto action) {
+            try {
+                action();
+            } catch(const std::invalid_argument&) {
+                return true;
+            }
+            return false;
+        };
+        ASSERT(throws_invalid_argument([&] { coordinator.AddDocument(4, "cat"s, SearchServer::DocumentStatus::ACTUAL, {1}); }));
+        ASSERT(throws_invalid_argument([&] { coordinator.FindTopDocuments("cat --dog"s); }));
+        bool thrown = false;
+        try {
+            coordinator.MatchDocument("cat"s, 100);
+        } catch(const std::out_of_range&) {
+            thrown = true;
+        }
+        ASSERT(thrown);
+        check_results();
+
+        // malformed requests get error responses and leave the node working
+        {
+            using namespace shard_protocol;
+            const Socket connection = ConnectTo(endpoints[0]);
+            MessageWriter bad_status;
+            bad_status.WriteUint8(static_cast<uint8_t>(RequestType::ADD_DOCUMENT));
+            bad_status.WriteInt32(30);
+            bad_status.WriteUint8(9);
+            MessageWriter bad_count;
+            bad_count.WriteUint8(static_cast<uint8_t>(RequestType::GET_TERM_STATISTICS));
+            bad_count.WriteUint32(0xffffffffu);
+            for(const MessageWriter* request : {&bad_status, &bad_count}) {
+                SendMessage(connection, request->GetPayload());
+                std::string response;
+                ASSERT(ReceiveMessage(connection, response));
+                ASSERT(static_cast<ResponseStatus>(response[0]) != ResponseStatus::OK);
+            }
+        }
+        check_results();
+
+        coordinator.Shutdown();
+        for(std::thread& thread : node_threads) {
+            thread.join();
+        }
+        for(int i = 0; i < 2; ++i) {
+            std::filesystem::remove(endpoints[i].substr("unix:"sv.size()));
+        }
+
+        // a node dying during a broadcast leaves the answer of another one
+        // unread, the coordinator must not take it for the next request's
+        {
+            using namespace shard_protocol;
+            ShardNode node(SearchServer("and with"s), "tcp:127.0.0.1:0"s);
+            const Socket dying_listener = ListenOn("tcp:127.0.0.1:0"s);
+            std::thread node_thread([&node] { node.Serve(); });
+            std::thread dying_thread([&dying_listener] {
+                const Socket connection(::accept(dying_listener.GetFd(), nullptr, nullptr));
+                // answers the stop words request, then dies on the next one
+                std::string request;
+                ReceiveMessage(connection, request);
+                MessageWriter stop_words;
+                stop_words.WriteUint8(static_cast<uint8_t>(ResponseStatus::OK));
+                stop_words.WriteUint32(0);
+                SendMessage(connection, stop_words.GetPayload());
+                ReceiveMessage(connection, request);
+            });
+
+            ShardCoordinator broken_coordinator({GetLocalEndpoint(dying_listener), node.GetEndpoint()});
+            broken_coordinator.AddDocument(1, "curly cat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+            auto get_error = [&broken_coordinator]() {
+                try {
+                    broken_coordinator.FindTopDocuments("cat"s);
+                } catch(const std::runtime_error& e) {
+                    return std::string(e.what());
+                }
+                return ""s;
+            };
+            ASSERT_EQUAL(get_error(), "shard connection closed"s);
+            ASSERT_EQUAL(get_error(), "coordinator is shut down"s);
+            dying_thread.join();
+
+            ShardCoordinator({node.GetEndpoint()}).Shutdown();
+            node_thread.join();
+        }
+    }
+
+    void TestQueryExecutor() {
+        QueryExecutor executor(4);
+        ASSERT_EQUAL(executor.GetWorkerCount(), 4);
+
+        std::vector<std::atomic<int>> visits(10000);
+        executor.ParallelFor(visits.size(), [&visits](size_t i) {
+            ++visits[i];
+        });
+        ASSERT(std::all_of(visits.begin(), visits.end(), [](const std::atomic<int>& count) {
+            return count == 1;
+        }));
+        {
+            // the chunks run by the calling thread are counted in the last row
+            const auto statistics = executor.GetWorkerStatistics();
+            ASSERT_EQUAL(statistics.size(), executor.GetWorkerCount() + 1);
+            uint64_t task_count = 0;
+            for(const QueryExecutor::WorkerStatistics& worker : statistics) {
+                task_count += worker.task_count_;
+            }
+            ASSERT_EQUAL(task_count, visits.size());
+        }
+
+        // a task may run a nested loop on the same executor
+        std::atomic<int> nested_count = 0;
+        executor.ParallelFor(8, [&executor, &nested_count](size_t) {
+            executor.ParallelFor(100, [&nested_count](size_t) {
+                ++nested_count;
+            });
+        });
+        ASSERT_EQUAL(nested_count.load(), 800);
+
+        bool is_thrown = false;
+        try {
+            executor.ParallelFor(1000, [](size_t i) {
+                if(i == 500) {
+                    throw std::runtime_error("task failed"s);
+                }
+            });
+        } catch(const std::runtime_error&) {
+            is_thrown = true;
+        }
+        ASSERT(is_thrown);
+
+        SearchServer server("and with"s);
+        std::mt19937 generator(3);
+        const std::vector<std::string> vocabulary = {"cat"s, "dog"s, "rat"s, "owl"s, "fox"s, "bee"s};
+        std::vector<std::string> queries;
+        for(int id = 0; id < 500; ++id) {
+            std::string text;
+            for(int i = 0; i < 4; ++i) {
+                text += vocabulary[generator() % vocabulary.size()] + " "s;
+            }
+            server.AddDocument(id, text, SearchServer::DocumentStatus::ACTUAL, {static_cast<int>(generator() % 10)});
+            queries.push_back(vocabulary[generator() % vocabulary.size()] + " -"s + vocabulary[generator() % vocabulary.size()]);
+        }
+        const auto expected = ProcessQueries(server, queries);
+        const auto results = ProcessQueries(executor, server, queries);
+        ASSERT_EQUAL(results.size(), expected.size());
+        for(size_t i = 0; i < results.size(); ++i) {
+            ASSERT_EQUAL(results[i].size(), expected[i].size());
+            for(size_t j = 0; j < results[i].size(); ++j) {
+                ASSERT_EQUAL(results[i][j].id_, expected[i][j].id_);
+            }
+        }
+        ASSERT_EQUAL(ProcessQueriesJoined(executor, server, queries).size(), ProcessQueriesJoined(server, queries).size());
+
+        // streamed documents come in query order whatever the window
+        const std::vector<SearchServer::Document> joined = ProcessQueriesJoined(server, queries);
+        for(size_t reorder_window : {1, 3, 1000}) {
+            std::vector<std::pair<size_t, int>> streamed;
+            ProcessQueriesJoined(executor, server, queries, 
+                [&streamed](size_t query_index, const SearchServer::Document& document) {
+                    streamed.emplace_back(query_index, document.id_);
+                }, reorder_window);
+            ASSERT_EQUAL(streamed.size(), joined.size());
+            for(size_t i = 0; i < streamed.size(); ++i) {
+                ASSERT_EQUAL(streamed[i].second, joined[i].id_);
+                ASSERT(i == 0 || streamed[i - 1].first <= streamed[i].first);
+            }
+        }
+        bool is_consumer_thrown = false;
+        try {
+            ProcessQueriesJoined(executor, server, queries, [](size_t query_index, const SearchServer::Document&) {
+                if(query_index >= 10) {
+                    throw std::runtime_error("consumer failed"s);
+                }
+            }, 4);
+        } catch(const std::runtime_error&) {
+            is_consumer_thrown = true;
+        }
+        ASSERT(is_consumer_thrown);
+
+        // a predicate may search the same server, the inner query gets its own scratch
+        const auto nested = server.FindTopDocuments("cat dog rat owl"s, [&server](int, SearchServer::DocumentStatus, int) {
+            return !server.FindTopDocuments("fox bee"s).empty();
+        });
+        const auto plain = server.FindTopDocuments("cat dog rat owl"s, [](int, SearchServer::DocumentStatus, int) {
+            return true;
+        });
+        ASSERT_EQUAL(nested.size(), plain.size());
+        for(size_t i = 0; i < nested.size(); ++i) {
+            ASSERT_EQUAL(nested[i].id_, plain[i].id_);
+        }
+
+        uint64_t task_count = 0;
+        for(const QueryExecutor::WorkerStatistics& statistics : executor.GetWorkerStatistics()) {
+            task_count += statistics.task_count_;
+            ASSERT(statistics.utilization_ >= 0.0 && statistics.utilization_ <= 1.0);
+        }
+        // the failed loop skips some of its tasks; every batch runs a task per
+        // distinct query and per shared word, and the streamed runs are cut
+        // into batches of their reorder window
+        ASSERT(task_count <= 10000 + 8 + 800 + 1000 + 8 * queries.size());
+    }
+
+    void TestConcurrentSearchServer() {
+        SearchServer initial("and with"s);
+        initial.AddDocument(0, "funny pet and nasty rat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        initial.AddDocument(1, "nasty rat with curly hair"s, SearchServer::DocumentStatus::ACTUAL, {2});
+        ConcurrentSearchServer server(initial);
+
+        {
+            // a query holding a snapshot keeps seeing it after a batch is published
+            std::shared_ptr<const SearchServer> first_snapshot = server.GetSnapshot();
+            server.ApplyBatch([](SearchServer& index) {
+                index.AddDocument(2, "rat"s, SearchServer::DocumentStatus::ACTUAL, {2});
+                index.AddDocument(3, "big rat"s, SearchServer::DocumentStatus::ACTUAL, {2});
+            });
+            ASSERT_EQUAL(first_snapshot->GetDocumentCount(), 2);
+            ASSERT_EQUAL(server.GetDocumentCount(), 4);
+        }
+
+        // every batch adds two documents, so a reader never sees an odd count
+        std::atomic<bool> done = false;
+        std::atomic<bool> consistent = true;
+        std::vector<std::thread> readers;
+        for(int i = 0; i < 4; ++i) {
+            readers.emplace_back([&server, &done, &consistent] {
+                while(!done) {
+                    std::shared_ptr<const SearchServer> snapshot = server.GetSnapshot();
+                    size_t found = snapshot->FindTopDocuments("rat"s).size();
+                    if(snapshot->GetDocumentCount() % 2 != 0 || 
+                            found != std::min<size_t>(snapshot->GetDocumentCount(), MAX_RESULT_DOCUMENT_COUNT)) {
+                        consistent = false;
+                    }
+                }
+            });
+        }
+        for(int id = 4; id < 40; id += 2) {
+            server.ApplyBatch([id](SearchServer& index) {
+                index.AddDocument(id, "rat"s, SearchServer::DocumentStatus::ACTUAL, {id});
+                index.AddDocument(id + 1, "big rat"s, SearchServer::DocumentStatus::ACTUAL, {id});
+            });
+        }
+        done = true;
+        for(std::thread& reader : readers) {
+            reader.join();
+        }
+
+        ASSERT(consistent);
+        ASSERT_EQUAL(server.GetVersion(), 19u);
+        ASSERT_EQUAL(server.GetDocumentCount(), 40);
+
+        bool thrown = false;
+        try {
+            server.ApplyBatch([](SearchServer& index) {
+                index.AddDocument(100, "cat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+                index.AddDocument(-1, "cat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+            });
+        } catch(const std::invalid_argument&) {
+            thrown = true;
+        }
+        ASSERT(thrown);
+        ASSERT_EQUAL(server.GetDocumentCount(), 40);
+        server.ApplyBatch([](SearchServer& index) {
+            index.AddDocument(100, "cat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        });
+        ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 1);
+
+        // a batch failing only on replay stays published and doesn't throw
+        int call_count = 0;
+        server.ApplyBatch([&call_count](SearchServer& index) {
+            if(++call_count == 2) {
+                throw std::runtime_error("replay failed");
+            }
+            index.AddDocument(101, "cat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        });
+        ASSERT_EQUAL(call_count, 2);
+        ASSERT_EQUAL(server.GetDocumentCount(), 42);
+        server.ApplyBatch([](SearchServer& index) {
+            index.AddDocument(102, "cat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        });
+        ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 3);
+    }
+
+    void TestQueryCache() {
+        SearchServer server("and in at"s);
+        server.AddDocument(1, "curly cat curly tail"s, SearchServer::DocumentStatus::ACTUAL, {7, 2, 7});
+        server.AddDocument(2, "curly dog and fancy collar"s, SearchServer::DocumentStatus::ACTUAL, {1, 2, 3});
+        server.AddDocument(3, "big cat fancy collar "s, SearchServer::DocumentStatus::BANNED, {1, 2, 8});
+
+        QueryCache cache(server, 1 << 20);
+        ASSERT_EQUAL(cache.FindTopDocuments("curly cat"s).size(), 2);
+        // the same words in another order, with duplicates, stop words and unknown words
+        ASSERT_EQUAL(cache.FindTopDocuments("cat and curly cat sparrow"s).size(), 2);
+        ASSERT_EQUAL(cache.FindTopDocuments("curly cat"s, SearchServer::DocumentStatus::BANNED).size(), 1);
+        ASSERT_EQUAL(cache.GetStatistics().hits_, 1u);
+        ASSERT_EQUAL(cache.GetStatistics().misses_, 2u);
+
+        server.AddDocument(4, "curly cat"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        ASSERT_EQUAL(cache.FindTopDocuments("curly cat"s).size(), 3);
+        ASSERT_EQUAL(cache.GetStatistics().misses_, 3u);
+        ASSERT_EQUAL(cache.GetStatistics().entry_count_, 1u);
+
+        // words only removed documents contained are dropped like unknown ones
+        server.AddDocument(5, "hamster"s, SearchServer::DocumentStatus::ACTUAL, {1});
+        server.RemoveDocument(5);
+        ASSERT_EQUAL(server.GetNormalizedQuery("curly hamster -hamster"s), server.GetNormalizedQuery("curly"s));
+
+        {
+            QueryCache small_cache(server, 400);
+            RequestQueue request_queue(server, small_cache);
+            for(const std::string& query : {"curly"s, "cat"s, "collar"s, "tail"s, "dog"s, "big"s}) {
+                ASSERT_EQUAL(request_queue.AddFindRequest(query).size(), server.FindTopDocuments(query).size());
+            }
+            QueryCache::Statistics statistics = small_cache.GetStatistics();
+            ASSERT(statistics.memory_used_ <= 400);
+            ASSERT(statistics.evictions_ > 0);
+            ASSERT_EQUAL(statistics.entry_count_ + statistics.evictions_, 6u);
+        }
+    }
+
     void TestPaginator() {
         {
             SearchServer search_server("and with"s);
@@ -250,7 +1520,7 @@ namespace {
             const auto pages_2 = Paginate(search_results, page_size_2);
             const auto pages_3 = Paginate(search_results, page_size_3);
             try {
-                const auto pages_4 = Paginate(search_results, page_size_4);
+                [[maybe_unused]] const auto pages_4 = Paginate(search_results, page_size_4);
             } catch(const std::invalid_argument& ia) {
                 ASSERT_EQUAL(ia.what(), "page size can't be 0!"s);
             }
@@ -259,6 +1529,59 @@ namespace {
             ASSERT_EQUAL(pages_2.size(), 1);
             ASSERT_EQUAL(pages_3.size(), 3);
         }
+        {
+            std::vector<int> numbers(103);
+            std::iota(numbers.begin(), numbers.end(), 0);
+            const auto pages = Paginate(numbers, 10);
+            static_assert(std::random_access_iterator<decltype(pages.begin())>);
+            ASSERT_EQUAL(pages.size(), 11);
+            ASSERT_EQUAL(*pages[7].begin(), 70);
+            ASSERT_EQUAL(pages[10].size(), 3);
+            ASSERT_EQUAL(pages.end() - pages.begin(), 11);
+            ASSERT_EQUAL(*pages.begin()[4].begin(), 40);
+
+            // forward iterators walk each page once
+            const std::list<int> listed(numbers.begin(), numbers.end());
+            int expected = 0;
+            size_t page_count = 0;
+            for(auto page : Paginate(listed, 10)) {
+                for(int number : page) {
+                    ASSERT_EQUAL(number, expected++);
+                }
+                ++page_count;
+            }
+            ASSERT_EQUAL(expected, 103);
+            ASSERT_EQUAL(page_count, 11);
+            ASSERT_EQUAL(*Paginate(listed, 10)[5].begin(), 50);
+        }
+        {
+            SearchServer search_server;
+            for(int id = 0; id < 95; ++id) {
+                search_server.AddDocument(id, "cat"s + (id % 2 == 0 ? " dog"s : ""s), SearchServer::DocumentStatus::ACTUAL, {id});
+            }
+            std::vector<size_t> fetched_offsets;
+            const auto pages = PaginateStream([&search_server, &fetched_offsets](size_t offset, size_t limit) {
+                fetched_offsets.push_back(offset);
+                return search_server.FindTopDocuments("cat"s, SearchServer::DocumentFilter{}, limit, offset);
+            }, 20);
+
+            // page 3 alone is fetched, not the ones before it
+            const std::vector<SearchServer::Document> page = pages[3];
+            ASSERT_EQUAL(page.size(), 20);
+            ASSERT((fetched_offsets == std::vector<size_t>{60}));
+            ASSERT(pages[5].empty());
+
+            fetched_offsets.clear();
+            std::set<int> ids;
+            for(const std::vector<SearchServer::Document>& documents : pages) {
+                for(const SearchServer::Document& document : documents) {
+                    ids.insert(document.id_);
+                }
+            }
+            ASSERT_EQUAL(ids.size(), 95);
+            // the short last page ends the iteration without another fetch
+            ASSERT((fetched_offsets == std::vector<size_t>{0, 20, 40, 60, 80}));
+        }
     }
 
     void TestRequestQueue() {
@@ -313,8 +1636,29 @@ void TestSearchServer() {
     RUN_TEST(TestRelevanceSort);
     RUN_TEST(TestRatingCounting);
     RUN_TEST(TestPredicate);
+    RUN_TEST(TestTopDocumentsLimit);
+    RUN_TEST(TestTopDocumentsPruning);
+    RUN_TEST(TestSearchPages);
+    RUN_TEST(TestQueryBatch);
+    RUN_TEST(TestScoringKernels);
     RUN_TEST(TestStatusPredicate);
+    RUN_TEST(TestDocumentFilter);
+    RUN_TEST(TestDocumentBitmap);
+    RUN_TEST(TestPostingList);
     RUN_TEST(TestRelevanceCounting);
+    RUN_TEST(TestSplitIntoWords);
+    RUN_TEST(TestTermDictionary);
+    RUN_TEST(TestWordFrequencies);
+    RUN_TEST(TestDocumentsBatchAdding);
+    RUN_TEST(TestDocumentRemoving);
+    RUN_TEST(TestDuplicatesRemoving);
+    RUN_TEST(TestIndexSnapshot);
+    RUN_TEST(TestSegmentedSearchServer);
+    RUN_TEST(TestShardedSearchServer);
+    RUN_TEST(TestShardCluster);
+    RUN_TEST(TestConcurrentSearchServer);
+    RUN_TEST(TestQueryExecutor);
+    RUN_TEST(TestQueryCache);
     RUN_TEST(TestPaginator);
     RUN_TEST(TestRequestQueue);
 }
@@ -0,0 +1,94 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace tokenizer_detail {
+    [[noreturn]] inline void ThrowUnacceptableSymbol() {
+        throw std::invalid_argument("Stop words can't contain special symbols (ASCII 0 - 32)");
+    }
+
+    inline bool IsControlByte(char ch) {
+        return static_cast<unsigned char>(ch) <= ' ';
+    }
+}
+
+// Calls word_handler(std::string_view) for every space separated word of text.
+// The views point into text, nothing is copied. Any other character with
+// code 0 - 32 makes the text invalid and std::invalid_argument is thrown.
+// Separators are searched 16 bytes at a time where SSE2 is available.
+template <typename WordHandler>
+void ForEachWord(std::string_view text, WordHandler word_handler) {
+    size_t word_begin = 0;
+    auto on_space = [&](size_t space_pos) {
+        if(space_pos > word_begin) {
+            word_handler(text.substr(word_begin, space_pos - word_begin));
+        }
+        word_begin = space_pos + 1;
+    };
+
+    size_t pos = 0;
+#ifdef __SSE2__
+    const __m128i spaces = _mm_set1_epi8(' ');
+    for(; pos + 16 <= text.size(); pos += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+        // unsigned byte <= 32 exactly when min(byte, 32) == byte
+        uint32_t control_mask = static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(chunk, spaces), chunk)));
+        if(control_mask == 0) {
+            continue;
+        }
+        uint32_t space_mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, spaces)));
+        if(control_mask != space_mask) {
+            tokenizer_detail::ThrowUnacceptableSymbol();
+        }
+        while(space_mask != 0) {
+            on_space(pos + std::countr_zero(space_mask));
+            space_mask &= space_mask - 1;
+        }
+    }
+#endif
+    for(; pos < text.size(); ++pos) {
+        if(text[pos] == ' ') {
+            on_space(pos);
+        } else if(tokenizer_detail::IsControlByte(text[pos])) {
+            tokenizer_detail::ThrowUnacceptableSymbol();
+        }
+    }
+    on_space(text.size());
+}
+
+inline std::vector<std::string_view> SplitIntoWords(std::string_view text) {
+    std::vector<std::string_view> words;
+    ForEachWord(text, [&words](std::string_view word) {
+        words.push_back(word);
+    });
+    return words;
+}
+
+// Calls word_handler(std::string_view word, bool is_minus) for every word of
+// a query that is_stop_word(word) rejects, the leading '-' of minus words is
+// stripped. Throws std::invalid_argument for words consisting of '-' alone
+// or starting with "--".
+template <typename StopWordPredicate, typename WordHandler>
+void ForEachQueryWord(std::string_view raw_query, StopWordPredicate is_stop_word, WordHandler word_handler) {
+    ForEachWord(raw_query, [&is_stop_word, &word_handler](std::string_view word) {
+        if(is_stop_word(word)) {
+            return;
+        }
+        if(word[0] == '-') {
+            if(word.size() == 1 || word[1] == '-') {
+                throw std::invalid_argument("Word can't be '-' or '--...'!");
+            }
+            word_handler(word.substr(1), true);
+        } else {
+            word_handler(word, false);
+        }
+    });
+}